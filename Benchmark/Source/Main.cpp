@@ -0,0 +1,426 @@
+#include "LengthDisassembler/Constexpr.hpp"
+#include "LengthDisassembler/Instructions.hpp"
+#include "LengthDisassembler/LengthDisassembler.hpp"
+#include "LengthDisassembler/Signature.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <print>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Mixes.hpp"
+
+using namespace LengthDisassembler;
+
+namespace {
+	// Repeat inputs until they are large enough to not fit into any cache.
+	constexpr std::size_t TARGET_SIZE = 64 * 1024 * 1024;
+	constexpr std::size_t MIX_SIZE = 16 * 1024 * 1024;
+
+	constexpr int RUNS = 5;
+
+	constexpr std::size_t SIGNATURE_COUNT = 256;
+
+	constexpr std::size_t PREDECESSOR_COUNT = 64 * 1024;
+	constexpr std::size_t PREDECESSOR_WINDOW = 64;
+
+	constexpr int bits_of(MachineMode mode)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return 16;
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return 32;
+		case MachineMode::LONG_MODE:
+			return 64;
+		default:
+			std::unreachable();
+		}
+	}
+
+	// Hex digits, optionally separated by spaces
+	std::optional<std::vector<std::byte>> parse_hex(std::string_view hex_string)
+	{
+		std::vector<std::byte> bytes;
+
+		for (std::size_t i = 0; i < hex_string.length();) {
+			if (hex_string[i] == ' ') {
+				i++;
+				continue;
+			}
+			if (i + 1 >= hex_string.length())
+				return std::nullopt;
+
+			const std::string hex_number{ hex_string.substr(i, 2) };
+			bytes.push_back(static_cast<std::byte>(std::stoi(hex_number, nullptr, 16)));
+			i += 2;
+		}
+
+		return bytes;
+	}
+
+	struct Corpus {
+		std::vector<std::byte> bytes;
+		std::vector<std::size_t> starts;
+	};
+
+	// The corpus consists of one instruction per line, concatenating them yields a buffer of valid instructions.
+	Corpus load_corpus(const char* path)
+	{
+		Corpus corpus;
+
+		std::ifstream file{ path };
+		for (std::string hex_string; std::getline(file, hex_string);) {
+			const std::optional<std::vector<std::byte>> instruction = parse_hex(hex_string);
+			if (!instruction.has_value() || instruction->empty())
+				continue;
+
+			corpus.starts.push_back(corpus.bytes.size());
+			corpus.bytes.insert(corpus.bytes.end(), instruction->begin(), instruction->end());
+		}
+
+		return corpus;
+	}
+
+	// Picks random instructions out of the mix, seeded so that every run measures the same buffer
+	std::optional<std::vector<std::byte>> build_mix(const Mixes::Mix& mix)
+	{
+		std::vector<std::vector<std::byte>> instructions;
+		for (const std::string_view hex_string : mix.instructions) {
+			std::optional<std::vector<std::byte>> instruction = parse_hex(hex_string);
+			if (!instruction.has_value())
+				return std::nullopt;
+
+			// Make sure the mix measures what it is supposed to
+			const std::expected<Instruction, Error> result = disassemble(instruction->data(), MachineMode::LONG_MODE, static_cast<std::uint8_t>(instruction->size()));
+			if (!result.has_value() || result->length != instruction->size())
+				return std::nullopt;
+
+			instructions.push_back(std::move(instruction.value()));
+		}
+
+		std::mt19937 random{ 0 };
+		std::uniform_int_distribution<std::size_t> distribution{ 0, instructions.size() - 1 };
+
+		std::vector<std::byte> bytes;
+		bytes.reserve(MIX_SIZE + MAX_INSTRUCTION_LENGTH);
+		while (bytes.size() < MIX_SIZE) {
+			const std::vector<std::byte>& instruction = instructions[distribution(random)];
+			bytes.insert(bytes.end(), instruction.begin(), instruction.end());
+		}
+
+		return bytes;
+	}
+
+	template <typename F>
+	double measure_best_of(int runs, F&& function)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (int i = 0; i < runs; i++) {
+			const auto start = std::chrono::steady_clock::now();
+			function();
+			const auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double>(end - start).count());
+		}
+		return best;
+	}
+
+	struct Result {
+		std::string group;
+		std::string name;
+		int bits;
+		std::size_t bytes;
+		std::size_t instructions;
+		double seconds;
+
+		double megabytes_per_second() const { return static_cast<double>(bytes) / seconds / 1e6; }
+		double nanoseconds_per_instruction() const { return seconds * 1e9 / static_cast<double>(instructions); }
+	};
+
+	std::string escape_json(std::string_view string)
+	{
+		std::string escaped;
+		for (const char c : string) {
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	void print_text(const char* corpus_path, const std::vector<Result>& results)
+	{
+		std::println("Corpus: {}", corpus_path);
+		std::println("{:<10} {:<28} {:>4} {:>10} {:>10}", "group", "name", "bits", "MB/s", "ns/insn");
+		for (const Result& result : results) {
+			std::println("{:<10} {:<28} {:>4} {:>10.2f} {:>10.2f}",
+				result.group,
+				result.name,
+				result.bits,
+				result.megabytes_per_second(),
+				result.nanoseconds_per_instruction());
+		}
+	}
+
+	void print_json(const char* corpus_path, const std::vector<Result>& results)
+	{
+		std::println("{{");
+		std::println("  \"corpus\": \"{}\",", escape_json(corpus_path));
+		std::println("  \"runs\": {},", RUNS);
+		std::println("  \"results\": [");
+		for (std::size_t i = 0; i < results.size(); i++) {
+			const Result& result = results[i];
+			std::println("    {{ \"group\": \"{}\", \"name\": \"{}\", \"bits\": {}, \"bytes\": {}, \"instructions\": {}, "
+						 "\"seconds\": {:.6f}, \"mb_per_second\": {:.2f}, \"ns_per_instruction\": {:.2f} }}{}",
+				result.group,
+				result.name,
+				result.bits,
+				result.bytes,
+				result.instructions,
+				result.seconds,
+				result.megabytes_per_second(),
+				result.nanoseconds_per_instruction(),
+				i + 1 < results.size() ? "," : "");
+		}
+		std::println("  ]");
+		std::println("}}");
+	}
+
+	// Decodes every instruction start of the corpus on its own, which works for every mode even though the
+	// corpus was compiled for 64-bit mode, as a sweep in the other modes would end up in different instructions.
+	template <MachineMode Mode>
+	Result measure_corpus_starts(const std::vector<std::byte>& code, const Corpus& corpus)
+	{
+		const std::size_t repetitions = code.size() / corpus.bytes.size();
+
+		const double seconds = measure_best_of(RUNS, [&] {
+			for (std::size_t repetition = 0; repetition < repetitions; repetition++) {
+				const std::size_t base = repetition * corpus.bytes.size();
+				for (const std::size_t start : corpus.starts) {
+					const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(code.size() - base - start, MAX_INSTRUCTION_LENGTH));
+					(void)disassemble<Mode>(code.data() + base + start, max_length);
+				}
+			}
+		});
+
+		return {
+			.group = "corpus",
+			.name = "disassemble (line starts)",
+			.bits = bits_of(Mode),
+			.bytes = code.size(),
+			.instructions = repetitions * corpus.starts.size(),
+			.seconds = seconds,
+		};
+	}
+
+	// How often every opcode occurs in the corpus, as `<map> <opcode> <count>` lines for `x86_parser --histogram`,
+	// which orders the range tables so that the frequent opcodes are found first.
+	void print_opcode_histogram(const char* corpus_path, const Corpus& corpus)
+	{
+		std::map<std::pair<std::uint8_t, std::uint8_t>, std::size_t> histogram;
+		for (const std::size_t start : corpus.starts) {
+			const std::span<const std::byte> bytes = std::span{ corpus.bytes }.subspan(start);
+			const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(bytes.size(), MAX_INSTRUCTION_LENGTH));
+			const std::expected<Instruction, Error> result = disassemble(bytes.data(), MachineMode::LONG_MODE, max_length);
+
+			// 3DNow instructions are decoded without looking at the opcode tables
+			if (result.has_value() && !result->is_3dnow)
+				histogram[{ result->opcode_map, result->opcode }]++;
+		}
+
+		std::println("# Opcode histogram of {} (64-bit), generated by LengthDisassemblerBench --opcode-histogram", std::filesystem::path{ corpus_path }.filename().string());
+		for (const auto& [opcode, count] : histogram)
+			std::println("{} {:02X} {}", opcode.first, opcode.second, count);
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	bool json = false;
+	bool opcode_histogram = false;
+	const char* corpus_path = LENGTHDISASSEMBLER_CORPUS;
+	for (int i = 1; i < argc; i++) {
+		if (std::string_view{ argv[i] } == "--json")
+			json = true;
+		else if (std::string_view{ argv[i] } == "--opcode-histogram")
+			opcode_histogram = true;
+		else
+			corpus_path = argv[i];
+	}
+
+	const Corpus corpus = load_corpus(corpus_path);
+	if (corpus.bytes.empty()) {
+		std::println(std::cerr, "Failed to load corpus from '{}'", corpus_path);
+		return 1;
+	}
+
+	if (opcode_histogram) {
+		print_opcode_histogram(corpus_path, corpus);
+		return 0;
+	}
+
+	std::vector<std::byte> code;
+	code.reserve(TARGET_SIZE + corpus.bytes.size());
+	while (code.size() < TARGET_SIZE)
+		code.insert(code.end(), corpus.bytes.begin(), corpus.bytes.end());
+
+	std::vector<std::uint8_t> lengths(code.size());
+	std::vector<Instruction> instructions(code.size());
+
+	std::vector<Result> results;
+
+	std::size_t instruction_count = 0;
+	const double sweep_seconds = measure_best_of(RUNS, [&] {
+		const std::expected<SweepResult, SweepError> result = sweep(code, lengths, MachineMode::LONG_MODE);
+		instruction_count = result.has_value() ? result->count : 0;
+	});
+
+	if (instruction_count == 0) {
+		std::println(std::cerr, "Sweep over the corpus failed");
+		return 1;
+	}
+
+	results.push_back({ "corpus", "sweep (lengths)", 64, code.size(), instruction_count, sweep_seconds });
+
+	const double sweep_instructions_seconds = measure_best_of(RUNS, [&] {
+		(void)sweep(code, lengths, instructions, MachineMode::LONG_MODE);
+	});
+	results.push_back({ "corpus", "sweep (instructions)", 64, code.size(), instruction_count, sweep_instructions_seconds });
+
+	const unsigned threads = std::max(std::thread::hardware_concurrency(), 1U);
+	const double parallel_sweep_seconds = measure_best_of(RUNS, [&] {
+		(void)parallel_sweep(code, lengths, MachineMode::LONG_MODE, threads);
+	});
+	results.push_back({ "corpus", std::format("parallel_sweep ({} threads)", threads), 64, code.size(), instruction_count, parallel_sweep_seconds });
+
+	const double loop_seconds = measure_best_of(RUNS, [&] {
+		std::byte* cursor = code.data();
+		std::byte* const end = code.data() + code.size();
+		std::size_t i = 0;
+		while (cursor < end) {
+			const auto remaining = static_cast<std::uint8_t>(std::min<std::ptrdiff_t>(end - cursor, MAX_INSTRUCTION_LENGTH));
+			const std::expected<Instruction, Error> result = disassemble(cursor, MachineMode::LONG_MODE, remaining);
+			if (!result.has_value())
+				break;
+			lengths[i++] = result->length;
+			cursor += result->length;
+		}
+	});
+	results.push_back({ "corpus", "disassemble loop", 64, code.size(), instruction_count, loop_seconds });
+
+	// The same loop with the mode as a template argument, which is still an out-of-line call into the library
+	const double template_loop_seconds = measure_best_of(RUNS, [&] {
+		std::byte* cursor = code.data();
+		std::byte* const end = code.data() + code.size();
+		std::size_t i = 0;
+		while (cursor < end) {
+			const auto remaining = static_cast<std::uint8_t>(std::min<std::ptrdiff_t>(end - cursor, MAX_INSTRUCTION_LENGTH));
+			const std::expected<Instruction, Error> result = disassemble<MachineMode::LONG_MODE>(cursor, remaining);
+			if (!result.has_value())
+				break;
+			lengths[i++] = result->length;
+			cursor += result->length;
+		}
+	});
+	results.push_back({ "corpus", "disassemble<Mode> loop", 64, code.size(), instruction_count, template_loop_seconds });
+
+	// Through "LengthDisassembler/Constexpr.hpp", the decoder is inlined into the loop and the unused fields are never computed
+	const double inline_loop_seconds = measure_best_of(RUNS, [&] {
+		std::byte* cursor = code.data();
+		std::byte* const end = code.data() + code.size();
+		std::size_t i = 0;
+		while (cursor < end) {
+			const auto remaining = static_cast<std::size_t>(std::min<std::ptrdiff_t>(end - cursor, MAX_INSTRUCTION_LENGTH));
+			const std::expected<Instruction, Error> result = disassemble<MachineMode::LONG_MODE>(std::span<const std::byte>{ cursor, remaining });
+			if (!result.has_value())
+				break;
+			lengths[i++] = result->length;
+			cursor += result->length;
+		}
+	});
+	results.push_back({ "corpus", "inline disassemble loop", 64, code.size(), instruction_count, inline_loop_seconds });
+
+	// The same loop written with the lazy view, which should compile to the same code
+	const double view_seconds = measure_best_of(RUNS, [&] {
+		std::size_t i = 0;
+		for (const DecodedInstruction& decoded : LengthDisassembler::instructions(code, MachineMode::LONG_MODE))
+			lengths[i++] = decoded.instruction.length;
+	});
+	results.push_back({ "corpus", "instructions view", 64, code.size(), instruction_count, view_seconds });
+
+	results.push_back(measure_corpus_starts<MachineMode::VIRTUAL8086>(code, corpus));
+	results.push_back(measure_corpus_starts<MachineMode::LONG_COMPATIBILITY_MODE>(code, corpus));
+	results.push_back(measure_corpus_starts<MachineMode::LONG_MODE>(code, corpus));
+
+	// Signatures of random instructions of the corpus, all of them are searched for at once
+	std::vector<Signature::Pattern> patterns;
+	std::mt19937 random{ 0 };
+	std::uniform_int_distribution<std::size_t> distribution{ 0, corpus.starts.size() - 1 };
+	for (std::size_t attempt = 0; attempt < SIGNATURE_COUNT * 2 && patterns.size() < SIGNATURE_COUNT; attempt++) {
+		std::expected<Signature::Pattern, Signature::GenerateError> pattern = Signature::generate(corpus.bytes, corpus.starts[distribution(random)]);
+		if (pattern.has_value())
+			patterns.push_back(std::move(pattern.value()));
+	}
+
+	const Signature::Scanner scanner{ patterns };
+	const double scan_seconds = measure_best_of(RUNS, [&] {
+		(void)scanner.scan(code);
+	});
+	results.push_back({ "signature", std::format("scan ({} patterns)", patterns.size()), 64, code.size(), instruction_count, scan_seconds });
+
+	// Predecessors of random instructions of the corpus, as when symbolizing return addresses
+	std::vector<std::size_t> targets;
+	for (std::size_t i = 0; i < PREDECESSOR_COUNT; i++) {
+		const std::size_t start = corpus.starts[distribution(random)];
+		if (start >= PREDECESSOR_WINDOW)
+			targets.push_back(start);
+	}
+
+	const double predecessor_seconds = measure_best_of(RUNS, [&] {
+		for (const std::size_t target : targets)
+			(void)find_predecessor(std::span{ corpus.bytes }.subspan(target - PREDECESSOR_WINDOW, PREDECESSOR_WINDOW), MachineMode::LONG_MODE);
+	});
+	results.push_back({ "backward", std::format("find_predecessor ({} bytes)", PREDECESSOR_WINDOW), 64, targets.size() * PREDECESSOR_WINDOW, targets.size(), predecessor_seconds });
+
+	for (const Mixes::Mix& mix : Mixes::ALL) {
+		const std::optional<std::vector<std::byte>> bytes = build_mix(mix);
+		if (!bytes.has_value()) {
+			std::println(std::cerr, "Mix '{}' contains an instruction that doesn't decode as listed", mix.name);
+			return 1;
+		}
+
+		std::size_t count = 0;
+		const double seconds = measure_best_of(RUNS, [&] {
+			const std::expected<SweepResult, SweepError> result = sweep(bytes.value(), lengths, MachineMode::LONG_MODE);
+			count = result.has_value() ? result->count : 0;
+		});
+
+		if (count == 0) {
+			std::println(std::cerr, "Sweep over mix '{}' failed", mix.name);
+			return 1;
+		}
+
+		results.push_back({ "mix", std::string{ mix.name }, 64, bytes->size(), count, seconds });
+	}
+
+	if (json)
+		print_json(corpus_path, results);
+	else
+		print_text(corpus_path, results);
+}
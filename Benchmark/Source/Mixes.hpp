@@ -0,0 +1,80 @@
+#ifndef LENGTHDISASSEMBLERBENCH_MIXES_HPP
+#define LENGTHDISASSEMBLERBENCH_MIXES_HPP
+
+#include <array>
+#include <span>
+#include <string_view>
+
+namespace Mixes {
+	// A synthetic mix consists of instructions that all take the same path through the decoder.
+	// Every instruction is valid in 64-bit mode and decodes to exactly the listed bytes.
+	struct Mix {
+		std::string_view name;
+		std::span<const std::string_view> instructions;
+	};
+
+	// Opcodes that are resolved through the generated opcode tables, without any prefixes
+	constexpr std::array TABLE_LOOKUP{
+		std::string_view{ "55" }, // push rbp
+		std::string_view{ "89 E5" }, // mov ebp, esp
+		std::string_view{ "8B 45 F8" }, // mov eax, [rbp-8]
+		std::string_view{ "0F B6 C0" }, // movzx eax, al
+		std::string_view{ "83 EC 20" }, // sub esp, 0x20
+		std::string_view{ "C3" }, // ret
+		std::string_view{ "0F 84 78 56 34 12" }, // jz rel32
+		std::string_view{ "0F 38 00 C1" }, // pshufb mm0, mm1
+		std::string_view{ "0F 3A 0F C1 08" }, // palignr mm0, mm1, 8
+		std::string_view{ "74 10" }, // jz rel8
+	};
+
+	// Legacy and REX prefixes in front of table lookups
+	constexpr std::array LEGACY{
+		std::string_view{ "66 2E 0F 1F 84 00 00 00 00 00" }, // nop word cs:[rax+rax]
+		std::string_view{ "F3 48 0F B8 C1" }, // popcnt rax, rcx
+		std::string_view{ "66 0F 6F C1" }, // movdqa xmm0, xmm1
+		std::string_view{ "F2 0F 10 45 F8" }, // movsd xmm0, [rbp-8]
+		std::string_view{ "F0 48 0F B1 0A" }, // lock cmpxchg [rdx], rcx
+		std::string_view{ "64 48 8B 04 25 28 00 00 00" }, // mov rax, fs:[0x28]
+		std::string_view{ "67 8B 00" }, // mov eax, [eax]
+		std::string_view{ "48 B8 01 02 03 04 05 06 07 08" }, // mov rax, imm64
+	};
+
+	constexpr std::array VEX{
+		std::string_view{ "C5 F8 77" }, // vzeroupper
+		std::string_view{ "C5 FD 6F 06" }, // vmovdqa ymm0, [rsi]
+		std::string_view{ "C4 E2 7D 18 06" }, // vbroadcastss ymm0, [rsi]
+		std::string_view{ "C4 E3 7D 19 C1 01" }, // vextractf128 xmm1, ymm0, 1
+		std::string_view{ "62 F1 7D 48 6F 06" }, // vmovdqa32 zmm0, [rsi]
+		std::string_view{ "62 F1 FD 48 6F 46 01" }, // vmovdqa64 zmm0, [rsi+0x40]
+		std::string_view{ "8F E8 78 C0 C1 05" }, // vprotb xmm0, xmm1, 5
+	};
+
+	constexpr std::array THREE_D_NOW{
+		std::string_view{ "0F 0F C1 9E" }, // pfadd mm0, mm1
+		std::string_view{ "0F 0F 46 10 B4" }, // pfmul mm0, [rsi+0x10]
+		std::string_view{ "0F 0F 04 24 A6" }, // pfrcpit1 mm0, [rsp]
+	};
+
+	// Instructions the generated tables can't describe, which are the special cases of the opcode tables
+	constexpr std::array EXPLICIT{
+		std::string_view{ "F7 C1 01 02 03 04" }, // test ecx, imm32
+		std::string_view{ "F6 C1 01" }, // test cl, 1
+		std::string_view{ "F7 D8" }, // neg eax
+		std::string_view{ "F6 45 F8 01" }, // test byte [rbp-8], 1
+		std::string_view{ "A1 01 02 03 04 05 06 07 08" }, // mov eax, moffs64
+		std::string_view{ "E8 78 56 34 12" }, // call rel32
+		std::string_view{ "E9 78 56 34 12" }, // jmp rel32
+		std::string_view{ "0F 20 C0" }, // mov rax, cr0
+		std::string_view{ "66 0F 78 C1 05 06" }, // extrq xmm1, 5, 6
+	};
+
+	constexpr std::array ALL{
+		Mix{ "table lookup", TABLE_LOOKUP },
+		Mix{ "legacy prefixes", LEGACY },
+		Mix{ "VEX/EVEX/XOP", VEX },
+		Mix{ "3DNow", THREE_D_NOW },
+		Mix{ "explicit handling", EXPLICIT },
+	};
+}
+
+#endif
@@ -1,111 +1,437 @@
-#include <cassert>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <format>
-#include <functional>
 #include <iostream>
+#include <optional>
 #include <print>
-#include <set>
 #include <span>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Zycore/Status.h"
+#include "Zydis/Decoder.h"
 #include "Zydis/DecoderTypes.h"
-#include "Zydis/Disassembler.h"
 #include "Zydis/SharedTypes.h"
-#include "Zydis/Zydis.h"
+
+namespace {
+	// Smaller chunks don't amortize starting a thread
+	constexpr std::size_t MIN_CHUNK_SIZE = 1024 * 1024;
+
+	// The amount of speculative instruction starts that are remembered per chunk, the true instruction stream nearly always joins within the first few
+	constexpr std::size_t SYNC_POINTS = 256;
+
+	constexpr std::uint8_t MASK_BYTE = 0x41; // Replaces addresses, so that they don't tell apart otherwise identical instructions
+
+	// A read-only memory mapping of the whole input
+	class Mapping {
+	public:
+		static std::optional<Mapping> open(const char* path)
+		{
+			const int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+			if (descriptor < 0)
+				return std::nullopt;
+
+			struct stat status{};
+			if (::fstat(descriptor, &status) < 0) {
+				::close(descriptor);
+				return std::nullopt;
+			}
+
+			Mapping mapping;
+			mapping.size = static_cast<std::size_t>(status.st_size);
+			if (mapping.size != 0) {
+				void* address = ::mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+				if (address == MAP_FAILED) {
+					::close(descriptor);
+					return std::nullopt;
+				}
+				mapping.address = address;
+
+				// Every chunk is walked front to back
+				(void)::madvise(address, mapping.size, MADV_SEQUENTIAL);
+			}
+
+			::close(descriptor);
+			return mapping;
+		}
+
+		Mapping(const Mapping&) = delete;
+		Mapping& operator=(const Mapping&) = delete;
+		Mapping(Mapping&& other) noexcept
+			: address(std::exchange(other.address, nullptr))
+			, size(std::exchange(other.size, 0))
+		{
+		}
+		Mapping& operator=(Mapping&&) = delete;
+		~Mapping()
+		{
+			if (address)
+				::munmap(address, size);
+		}
+
+		std::span<const std::uint8_t> bytes() const { return { static_cast<const std::uint8_t*>(address), size }; }
+
+	private:
+		Mapping() = default;
+
+		void* address = nullptr;
+		std::size_t size = 0;
+	};
+
+	// Decodes the instruction at `offset`. Undecodable bytes are skipped one at a time, which makes the next offset a function of
+	// the current one alone, so that two walks that meet at the same offset stay together from there on.
+	bool decode_at(const ZydisDecoder& decoder, std::span<const std::uint8_t> bytes, std::size_t offset, ZydisDecodedInstruction& instruction)
+	{
+		return ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&decoder, nullptr, bytes.data() + offset, bytes.size() - offset, &instruction));
+	}
+
+	std::size_t next_offset(const ZydisDecoder& decoder, std::span<const std::uint8_t> bytes, std::size_t offset)
+	{
+		ZydisDecodedInstruction instruction;
+		return offset + (decode_at(decoder, bytes, offset, instruction) ? instruction.length : 1);
+	}
+
+	// Two instructions with the same shape are encoded alike and only differ in their registers, displacements or immediates.
+	// One of them exercises the length disassembler just as well as all of them.
+	struct Shape {
+		std::uint64_t opcode; // Encoding, opcode map, opcode, mnemonic and prefixes
+		std::uint64_t fields; // ModRM class and the size of every field
+
+		bool operator==(const Shape&) const = default;
+	};
+
+	constexpr std::uint64_t prefix_bit(std::uint8_t prefix)
+	{
+		switch (prefix) {
+		case 0x66:
+			return 1 << 0;
+		case 0x67:
+			return 1 << 1;
+		case 0xF0:
+			return 1 << 2;
+		case 0xF2:
+			return 1 << 3;
+		case 0xF3:
+			return 1 << 4;
+		case 0x26:
+			return 1 << 5;
+		case 0x2E:
+			return 1 << 6;
+		case 0x36:
+			return 1 << 7;
+		case 0x3E:
+			return 1 << 8;
+		case 0x64:
+			return 1 << 9;
+		case 0x65:
+			return 1 << 10;
+		default:
+			return (prefix & 0xF0) == 0x40 ? 1 << 11 : 1 << 12; // REX
+		}
+	}
+
+	Shape shape_of(const ZydisDecodedInstruction& instruction)
+	{
+		std::uint64_t prefixes = 0;
+		for (std::uint8_t i = 0; i < instruction.raw.prefix_count; i++)
+			prefixes |= prefix_bit(instruction.raw.prefixes[i].value);
+
+		Shape shape{
+			.opcode = static_cast<std::uint64_t>(instruction.encoding)
+				| static_cast<std::uint64_t>(instruction.opcode_map) << 8
+				| static_cast<std::uint64_t>(instruction.opcode) << 16
+				| static_cast<std::uint64_t>(instruction.mnemonic) << 24
+				| prefixes << 40
+				| static_cast<std::uint64_t>(instruction.raw.prefix_count) << 56
+				| static_cast<std::uint64_t>(instruction.raw.rex.W) << 60,
+			.fields = 0,
+		};
+
+		if (instruction.attributes & ZYDIS_ATTRIB_HAS_MODRM) {
+			const bool has_sib = instruction.attributes & ZYDIS_ATTRIB_HAS_SIB;
+			shape.fields = 1
+				| static_cast<std::uint64_t>(instruction.raw.modrm.mod) << 1
+				| static_cast<std::uint64_t>(has_sib) << 3
+				| static_cast<std::uint64_t>(instruction.raw.modrm.mod == 0 && instruction.raw.modrm.rm == 0b101) << 4 // [disp32] or [rip + disp32]
+				| static_cast<std::uint64_t>(has_sib && instruction.raw.sib.base == 0b101) << 5; // No base with mod 0
+		}
+
+		shape.fields |= static_cast<std::uint64_t>(instruction.raw.disp.size) << 8
+			| static_cast<std::uint64_t>(instruction.raw.imm[0].size) << 16
+			| static_cast<std::uint64_t>(instruction.raw.imm[1].size) << 24
+			| static_cast<std::uint64_t>(instruction.length) << 32;
+
+		return shape;
+	}
+
+	// The bytes of an instruction that get replaced by MASK_BYTE, one bit per byte
+	std::uint16_t mask_of(const ZydisDecodedInstruction& instruction)
+	{
+		const auto bits = [](std::uint8_t offset, std::uint8_t size_in_bits) {
+			return static_cast<std::uint16_t>(((1U << (size_in_bits / 8)) - 1) << offset);
+		};
+
+		std::uint16_t mask = bits(instruction.raw.disp.offset, instruction.raw.disp.size);
+		for (const auto& immediate : instruction.raw.imm)
+			if (immediate.is_relative)
+				mask |= bits(immediate.offset, immediate.size);
+		return mask;
+	}
+
+	struct Sample {
+		std::size_t offset;
+		std::uint8_t length;
+		std::uint16_t mask;
+	};
+
+	// Keeps the first sample of every shape, in a flat open-addressing table with linear probing
+	class ShapeTable {
+	public:
+		ShapeTable()
+			: slots(1 << 12)
+		{
+		}
+
+		void insert(const Shape& shape, const Sample& sample)
+		{
+			if (2 * (count + 1) > slots.size())
+				grow();
+
+			Slot& slot = find(shape);
+			if (!slot.used) {
+				slot = { .shape = shape, .sample = sample, .used = true };
+				count++;
+			}
+		}
+
+		void merge(const ShapeTable& other)
+		{
+			for (const Slot& slot : other.slots)
+				if (slot.used)
+					insert(slot.shape, slot.sample);
+		}
+
+		std::vector<Sample> samples() const
+		{
+			std::vector<Sample> samples;
+			samples.reserve(count);
+			for (const Slot& slot : slots)
+				if (slot.used)
+					samples.push_back(slot.sample);
+			return samples;
+		}
+
+	private:
+		struct Slot {
+			Shape shape;
+			Sample sample;
+			bool used;
+		};
+
+		static std::size_t hash(const Shape& shape)
+		{
+			// splitmix64's finalizer
+			std::uint64_t x = shape.opcode ^ std::rotl(shape.fields, 32) * 0x9E3779B97F4A7C15;
+			x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+			x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+			return static_cast<std::size_t>(x ^ (x >> 31));
+		}
+
+		Slot& find(const Shape& shape)
+		{
+			const std::size_t mask = slots.size() - 1;
+			for (std::size_t index = hash(shape) & mask;; index = (index + 1) & mask)
+				if (!slots[index].used || slots[index].shape == shape)
+					return slots[index];
+		}
+
+		void grow()
+		{
+			std::vector<Slot> old = std::exchange(slots, std::vector<Slot>(2 * slots.size()));
+			for (const Slot& slot : old)
+				if (slot.used)
+					find(slot.shape) = slot;
+		}
+
+		std::vector<Slot> slots;
+		std::size_t count = 0;
+	};
+
+	struct Chunk {
+		std::size_t begin;
+		std::size_t end;
+
+		// The first instruction starts when decoding from `begin`, which may not be an instruction boundary
+		std::vector<std::size_t> sync_points;
+		std::size_t speculative_exit; // The first instruction start at or past `end` when decoding from `begin`
+
+		std::size_t true_begin; // The first true instruction start at or past `begin`
+
+		ShapeTable shapes;
+		std::size_t instructions = 0;
+		std::size_t undecodable_bytes = 0;
+	};
+
+	void decode_speculatively(const ZydisDecoder& decoder, std::span<const std::uint8_t> bytes, Chunk& chunk)
+	{
+		std::size_t offset = chunk.begin;
+		for (; offset < chunk.end; offset = next_offset(decoder, bytes, offset))
+			if (chunk.sync_points.size() < SYNC_POINTS)
+				chunk.sync_points.push_back(offset);
+		chunk.speculative_exit = offset;
+	}
+
+	// Follows the true instruction stream from `true_begin` until it either joins the speculative one or leaves the chunk
+	std::size_t true_exit(const ZydisDecoder& decoder, std::span<const std::uint8_t> bytes, const Chunk& chunk)
+	{
+		std::size_t offset = chunk.true_begin;
+		for (; offset < chunk.end; offset = next_offset(decoder, bytes, offset))
+			if (std::ranges::binary_search(chunk.sync_points, offset))
+				return chunk.speculative_exit;
+		return offset;
+	}
+
+	void collect_shapes(const ZydisDecoder& decoder, std::span<const std::uint8_t> bytes, Chunk& chunk)
+	{
+		ZydisDecodedInstruction instruction;
+		for (std::size_t offset = chunk.true_begin; offset < chunk.end;) {
+			if (!decode_at(decoder, bytes, offset, instruction)) {
+				chunk.undecodable_bytes++;
+				offset++;
+				continue;
+			}
+
+			chunk.shapes.insert(shape_of(instruction), { .offset = offset, .length = instruction.length, .mask = mask_of(instruction) });
+			chunk.instructions++;
+			offset += instruction.length;
+		}
+	}
+
+	// Calls `work(chunk)` for every chunk, each on its own thread
+	template <typename Work>
+	void for_each_chunk(std::span<Chunk> chunks, Work work)
+	{
+		std::vector<std::jthread> workers;
+		workers.reserve(chunks.size() - 1);
+		for (Chunk& chunk : chunks.subspan(1))
+			workers.emplace_back([&work, &chunk] { work(chunk); });
+
+		work(chunks[0]);
+	}
+}
 
 int main(int argc, const char** argv)
 {
-	assert(argc == 3);
+	if (argc < 3 || argc > 4) {
+		std::println(std::cerr, "Usage: {} <16/32/64> <file> [threads]", argv[0]);
+		return 1;
+	}
 
 	ZydisMachineMode mode = ZYDIS_MACHINE_MODE_LONG_64;
+	ZydisStackWidth stack_width = ZYDIS_STACK_WIDTH_64;
 	if (strcmp(argv[1], "16") == 0) {
 		mode = ZYDIS_MACHINE_MODE_REAL_16;
+		stack_width = ZYDIS_STACK_WIDTH_16;
 	} else if (strcmp(argv[1], "32") == 0) {
 		mode = ZYDIS_MACHINE_MODE_LONG_COMPAT_32;
+		stack_width = ZYDIS_STACK_WIDTH_32;
 	} else if (strcmp(argv[1], "64") == 0) {
 		mode = ZYDIS_MACHINE_MODE_LONG_64;
+		stack_width = ZYDIS_STACK_WIDTH_64;
 	} else {
 		std::println(std::cerr, "Expected 16/32/64 bit as argv[1], got '{}'", argv[1]);
 		return 1;
 	}
 
-	FILE* h = fopen(argv[2], "r");
+	unsigned threads = argc == 4 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 1U);
 
-	if (!h) {
-		perror("fopen");
+	const std::optional<Mapping> mapping = Mapping::open(argv[2]);
+	if (!mapping.has_value()) {
+		std::println(std::cerr, "{}: Failed to map file ({})", argv[2], std::strerror(errno));
 		return 1;
 	}
 
-	std::set<std::size_t> hashes;
+	const auto start = std::chrono::steady_clock::now();
 
-	std::uint8_t buf[32];
-	while (!feof(h)) {
-		const std::size_t i = fread(buf, 1, 32, h);
-		if (i < 32)
-			break;
-		if (fseek(h, -32, SEEK_CUR) < 0) {
-			perror("fseek");
-			return 1;
-		}
+	// The decoder only holds its configuration, so it can be shared between threads
+	ZydisDecoder decoder;
+	if (!ZYAN_SUCCESS(ZydisDecoderInit(&decoder, mode, stack_width))) {
+		std::println(std::cerr, "Failed to initialize Zydis");
+		return 1;
+	}
 
-		ZydisDisassembledInstruction instruction{};
-		if (!ZYAN_SUCCESS(ZydisDisassembleIntel(mode,
-				0,
-				buf,
-				sizeof(buf),
-				&instruction))) {
-			std::println(std::cerr, "Failed to disassemble instruction at {}", ftell(h));
-			if (fseek(h, 1, SEEK_CUR) < 0) {
-				perror("fseek");
-				return 1;
-			}
-			continue;
-		}
-		if (fseek(h, instruction.info.length, SEEK_CUR) < 0) {
-			perror("fseek");
-			return 1;
-		}
+	const std::span<const std::uint8_t> bytes = mapping->bytes();
 
-		for (const auto& op : instruction.operands) {
-			switch (op.type) {
-			case ZYDIS_OPERAND_TYPE_UNUSED:
-			case ZYDIS_OPERAND_TYPE_REGISTER:
-				continue;
-			case ZYDIS_OPERAND_TYPE_MEMORY:
-				if (op.mem.type == ZYDIS_MEMOP_TYPE_MEM || op.mem.type == ZYDIS_MEMOP_TYPE_AGEN) {
-					for (int j = op.mem.disp.offset; j < op.mem.disp.offset + op.mem.disp.size / 8; j++) {
-						buf[j] = 0x41;
-					}
-				}
-				break;
-			case ZYDIS_OPERAND_TYPE_POINTER:
-				continue;
-			case ZYDIS_OPERAND_TYPE_IMMEDIATE:
-				if (op.imm.is_relative) {
-					for (int j = op.imm.offset; j < op.imm.offset + op.imm.size / 8; j++) {
-						buf[j] = 0x41;
-					}
-				}
+	const std::size_t chunk_count = std::clamp<std::size_t>(bytes.size() / MIN_CHUNK_SIZE, 1, threads);
+	const std::size_t chunk_size = bytes.size() / chunk_count;
 
-				break;
-			}
-		}
+	std::vector<Chunk> chunks(chunk_count);
+	for (std::size_t i = 0; i < chunk_count; i++) {
+		chunks[i].begin = i * chunk_size;
+		chunks[i].end = i + 1 == chunk_count ? bytes.size() : (i + 1) * chunk_size;
+	}
 
-		std::string nibbles;
-		for (std::uint8_t x : std::span<std::uint8_t>(buf, buf + instruction.info.length)) {
-			nibbles += std::format("{:02x}", x);
-		}
+	// Every chunk but the first starts at a guessed instruction boundary, the true stream is found by following it from
+	// the end of the previous chunk until it meets the speculative stream. Then all chunks are decoded a second time from their true start.
+	for_each_chunk(chunks, [&decoder, bytes](Chunk& chunk) { decode_speculatively(decoder, bytes, chunk); });
+
+	chunks[0].true_begin = 0;
+	for (std::size_t i = 1; i < chunk_count; i++)
+		chunks[i].true_begin = true_exit(decoder, bytes, chunks[i - 1]);
+
+	for_each_chunk(chunks, [&decoder, bytes](Chunk& chunk) { collect_shapes(decoder, bytes, chunk); });
+
+	// Merging in order keeps the first sample of every shape
+	ShapeTable shapes;
+	std::size_t instructions = 0;
+	std::size_t undecodable_bytes = 0;
+	for (const Chunk& chunk : chunks) {
+		shapes.merge(chunk.shapes);
+		instructions += chunk.instructions;
+		undecodable_bytes += chunk.undecodable_bytes;
+	}
+
+	std::vector<Sample> samples = shapes.samples();
+	std::ranges::sort(samples, {}, &Sample::offset);
+
+	constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
 
-		const std::size_t hash = std::hash<std::string>{}(nibbles);
-		if (!hashes.contains(hash)) {
-			std::println("{}", nibbles);
-			hashes.insert(hash);
+	std::string output;
+	output.reserve(samples.size() * 12);
+	for (const Sample& sample : samples) {
+		for (std::uint8_t i = 0; i < sample.length; i++) {
+			const std::uint8_t byte = (sample.mask >> i) & 1 ? MASK_BYTE : bytes[sample.offset + i];
+			output += HEX_DIGITS[byte >> 4];
+			output += HEX_DIGITS[byte & 0xF];
 		}
+		output += '\n';
+	}
+
+	if (std::fwrite(output.data(), 1, output.size(), stdout) != output.size()) {
+		perror("fwrite");
+		return 1;
 	}
 
-	(void)fclose(h);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	std::println(std::cerr, "{} bytes, {} instructions, {} undecodable bytes, {} shapes in {} ms",
+		bytes.size(),
+		instructions,
+		undecodable_bytes,
+		samples.size(),
+		elapsed.count());
 }
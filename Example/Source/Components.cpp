@@ -0,0 +1,978 @@
+#include "Components.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "LengthDisassembler/Boundaries.hpp"
+#include "LengthDisassembler/Detail/Lengths.hpp"
+#include "LengthDisassembler/Detail/ParallelSweep.hpp"
+#include "LengthDisassembler/Detail/Signature.hpp"
+#include "LengthDisassembler/LengthDisassembler.hpp"
+#include "LengthDisassembler/Signature.hpp"
+#include "LengthDisassembler/Stream.hpp"
+
+// The index maps files with POSIX APIs and is only built on Unix
+#if defined(__unix__)
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#include "LengthDisassembler/Elf.hpp"
+#include "LengthDisassembler/Index.hpp"
+#endif
+
+using namespace LengthDisassembler;
+
+namespace {
+	// An opcode that is unknown in every machine mode
+	constexpr std::array UNKNOWN_INSTRUCTION{ std::byte{ 0x0F }, std::byte{ 0x3F } };
+
+	constexpr int bits_of(MachineMode mode)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return 16;
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return 32;
+		case MachineMode::LONG_MODE:
+			return 64;
+		default:
+			std::unreachable();
+		}
+	}
+
+	std::string describe(const std::expected<SweepResult, SweepError>& result)
+	{
+		if (result.has_value())
+			return std::format("{} instructions up to offset {}", result->count, result->offset);
+		return std::format("error {} after {} instructions at offset {}", std::to_underlying(result.error().error), result.error().count, result.error().offset);
+	}
+
+	// How two sweeps differ in their results or in the lengths written before them, std::nullopt if they don't
+	std::optional<std::string> compare_sweeps(const std::expected<SweepResult, SweepError>& expected,
+		std::span<const std::uint8_t> expected_lengths,
+		const std::expected<SweepResult, SweepError>& actual,
+		std::span<const std::uint8_t> actual_lengths)
+	{
+		if (describe(expected) != describe(actual))
+			return std::format("expected {}, got {}", describe(expected), describe(actual));
+
+		const std::size_t count = expected.has_value() ? expected->count : expected.error().count;
+		const auto [expected_length, actual_length] = std::ranges::mismatch(expected_lengths.first(count), actual_lengths.first(count));
+		if (expected_length != expected_lengths.first(count).end())
+			return std::format("the length of instruction {} is {} instead of {}", expected_length - expected_lengths.begin(), *actual_length, *expected_length);
+
+		return std::nullopt;
+	}
+
+	// What `parallel_sweep_skipping` has to return, by resuming `sweep` one byte after every error
+	SweepResult sweep_skipping(std::span<const std::byte> bytes, std::span<std::uint8_t> lengths, MachineMode mode)
+	{
+		std::size_t count = 0;
+		std::size_t offset = 0;
+		while (offset < bytes.size() && count < lengths.size()) {
+			const std::expected<SweepResult, SweepError> result = sweep(bytes.subspan(offset), lengths.subspan(count), mode);
+			if (result.has_value())
+				return { .count = count + result->count, .offset = offset + result->offset };
+
+			count += result.error().count;
+			offset += result.error().offset;
+
+			lengths[count++] = 0;
+			offset++;
+		}
+		return { .count = count, .offset = offset };
+	}
+
+	// The code as is, cut off in the middle of its last instruction, and with an unknown instruction three quarters of the way in,
+	// so that the sweeps fail in a later chunk than the first one, or skip a byte there and have to find back into the code.
+	// Last, the code backwards, which is hardly code anymore and makes the sweeps skip a byte every so often.
+	std::vector<std::vector<std::byte>> sweep_inputs(const Components::Code& code)
+	{
+		std::vector<std::vector<std::byte>> inputs{ code.bytes };
+		if (code.starts.empty())
+			return inputs;
+
+		inputs.emplace_back(code.bytes.begin(), code.bytes.end() - 1);
+
+		std::vector<std::byte> unknown = code.bytes;
+		const std::size_t at = code.starts[code.starts.size() * 3 / 4];
+		unknown.insert(unknown.begin() + static_cast<std::ptrdiff_t>(at), UNKNOWN_INSTRUCTION.begin(), UNKNOWN_INSTRUCTION.end());
+		inputs.push_back(std::move(unknown));
+
+		inputs.emplace_back(code.bytes.rbegin(), code.bytes.rend());
+
+		return inputs;
+	}
+
+	// The first bytes of the shortcut's instructions, and prefixes that it leaves to the decoder
+	constexpr std::array<std::initializer_list<std::uint8_t>, 10> SHORTCUT_PREFIXES{ {
+		{},
+		{ 0x66 },
+		{ 0xF3 },
+		{ 0x67 },
+		{ 0x48 },
+		{ 0x41 },
+		{ 0x66, 0x48 },
+		{ 0xF2, 0x4C },
+		{ 0x48, 0x66 },
+		{ 0xF3, 0x66 },
+	} };
+
+	// Compares the shortcut with the decoder behind every prefix of SHORTCUT_PREFIXES, with and without the escape byte, for every opcode and ModRM byte,
+	// followed by a SIB byte with and without a base. The bytes after them are filled with 0xFF, which none of the shortcut's instructions depend on.
+	template <MachineMode Mode>
+	std::optional<std::string> compare_shortcut()
+	{
+		std::array<std::byte, Detail::Lengths::LOOKAHEAD> bytes{};
+
+		for (const std::initializer_list<std::uint8_t> prefixes : SHORTCUT_PREFIXES) {
+			for (const bool escape : { false, true }) {
+				for (std::size_t opcode = 0; opcode < 256; opcode++) {
+					for (std::size_t modrm = 0; modrm < 256; modrm++) {
+						for (const std::uint8_t sib : { 0x24, 0x25 }) {
+							std::ranges::fill(bytes, std::byte{ 0xFF });
+							std::size_t size = 0;
+							for (const std::uint8_t prefix : prefixes)
+								bytes[size++] = std::byte{ prefix };
+							if (escape)
+								bytes[size++] = std::byte{ 0x0F };
+							bytes[size++] = std::byte(opcode);
+							bytes[size++] = std::byte(modrm);
+							bytes[size++] = std::byte{ sib };
+
+							const std::uint8_t length = Detail::Lengths::shortcut<Mode>(bytes.data());
+							if (length == 0)
+								continue;
+
+							const std::expected<Instruction, Error> instruction = disassemble<Mode>(bytes.data(), static_cast<std::uint8_t>(bytes.size()));
+							if (!instruction.has_value() || instruction->length != length) {
+								std::string hex;
+								for (const std::byte byte : std::span{ bytes }.first(size))
+									hex += std::format("{:02x}", std::to_integer<int>(byte));
+
+								return std::format("the shortcut takes {} as {} bytes, the decoder as {}",
+									hex,
+									length,
+									instruction.has_value() ? std::format("{} bytes", instruction->length) : std::format("error {}", std::to_underlying(instruction.error())));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	// Feeds `bytes` to a stream decoder in pieces of `piece_size` bytes, with room for `capacity` lengths per call
+	std::optional<std::string> compare_stream(std::span<const std::byte> bytes, MachineMode mode, std::size_t piece_size, std::size_t capacity)
+	{
+		std::vector<std::uint8_t> expected_lengths(bytes.size());
+		const std::expected<SweepResult, SweepError> expected = sweep(bytes, expected_lengths, mode);
+		expected_lengths.resize(expected.has_value() ? expected->count : expected.error().count);
+
+		StreamDecoder decoder{ mode };
+		std::vector<std::uint8_t> lengths(capacity);
+		std::vector<std::uint8_t> decoded;
+		std::optional<SweepError> failure;
+
+		for (std::size_t begin = 0; begin < bytes.size() && !failure.has_value(); begin += piece_size) {
+			std::span<const std::byte> piece = bytes.subspan(begin, std::min(piece_size, bytes.size() - begin));
+			while (!piece.empty()) {
+				const std::expected<SweepResult, SweepError> result = decoder.feed(piece, lengths);
+				if (!result.has_value()) {
+					// The lengths in front of the error have been written as well
+					decoded.insert(decoded.end(), lengths.begin(), lengths.begin() + static_cast<std::ptrdiff_t>(result.error().count));
+					failure = result.error();
+					break;
+				}
+				if (result->count == 0 && result->offset == 0)
+					return std::format("feeding stopped at {}", begin + bytes.size() - piece.size());
+
+				decoded.insert(decoded.end(), lengths.begin(), lengths.begin() + static_cast<std::ptrdiff_t>(result->count));
+				piece = piece.subspan(result->offset);
+			}
+		}
+
+		while (!failure.has_value()) {
+			const std::expected<SweepResult, SweepError> result = decoder.finish(lengths);
+			if (!result.has_value()) {
+				decoded.insert(decoded.end(), lengths.begin(), lengths.begin() + static_cast<std::ptrdiff_t>(result.error().count));
+				failure = result.error();
+				break;
+			}
+
+			decoded.insert(decoded.end(), lengths.begin(), lengths.begin() + static_cast<std::ptrdiff_t>(result->count));
+			if (result->count < lengths.size())
+				break;
+		}
+
+		if (expected.has_value() && failure.has_value())
+			return std::format("failed with error {} at {}, but the sweep succeeds", std::to_underlying(failure->error), failure->offset);
+		if (!expected.has_value() && !failure.has_value())
+			return std::format("succeeded, but the sweep fails with error {} at {}", std::to_underlying(expected.error().error), expected.error().offset);
+		if (failure.has_value() && (failure->error != expected.error().error || failure->offset != expected.error().offset))
+			return std::format("failed with error {} at {} instead of error {} at {}",
+				std::to_underlying(failure->error),
+				failure->offset,
+				std::to_underlying(expected.error().error),
+				expected.error().offset);
+
+		const auto [expected_length, length] = std::ranges::mismatch(expected_lengths, decoded);
+		if (expected_length != expected_lengths.end() || length != decoded.end())
+			return std::format("decoded {} instructions, the first {} of them the same as the sweep's {}",
+				decoded.size(),
+				expected_length - expected_lengths.begin(),
+				expected_lengths.size());
+
+		return std::nullopt;
+	}
+
+	// A case of `find_predecessor` and `find_call_site` in 64-bit code, with the offsets of the instructions they have to find
+	struct PredecessorCase {
+		std::string_view name;
+		std::vector<std::uint8_t> bytes;
+		std::expected<std::size_t, Error> predecessor;
+		std::expected<std::size_t, Error> call_site;
+	};
+
+	// The prologue of a function, `push rbp; mov rbp, rsp; sub rsp, 0x10; mov [rbp-4], edi`, in front of the ambiguous tails
+	constexpr std::array<std::uint8_t, 11> PROLOGUE{ 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x10, 0x89, 0x7D, 0xFC };
+
+	std::vector<std::uint8_t> with_prologue(std::initializer_list<std::uint8_t> tail)
+	{
+		std::vector<std::uint8_t> bytes(PROLOGUE.size() + tail.size());
+		std::ranges::copy(tail, std::ranges::copy(PROLOGUE, bytes.begin()).out);
+		return bytes;
+	}
+
+	std::vector<PredecessorCase> predecessor_cases()
+	{
+		return {
+			{ "nothing", {}, std::unexpected(Error::NO_MORE_DATA), std::unexpected(Error::NO_MORE_DATA) },
+			{ "a cut off escape byte", { 0x0F }, std::unexpected(Error::UNKNOWN_INSTRUCTION), std::unexpected(Error::UNKNOWN_INSTRUCTION) },
+			{ "a ret at the start of the buffer", { 0xC3 }, 0, std::unexpected(Error::UNKNOWN_INSTRUCTION) },
+			// `mov rax, [rip+0x44332211]`, `mov eax, [rip+...]` and `add eax, 0x44332211` each get a single vote, the longest chain wins
+			{ "a RIP-relative mov at the start of the buffer", { 0x48, 0x8B, 0x05, 0x11, 0x22, 0x33, 0x44 }, 0, std::unexpected(Error::UNKNOWN_INSTRUCTION) },
+			// `mov eax, 0x90909090` alone loses against the four nops in its immediate, the code in front of it only chains into the mov
+			{ "a mov with nops as its immediate", { 0xB8, 0x90, 0x90, 0x90, 0x90 }, 4, std::unexpected(Error::UNKNOWN_INSTRUCTION) },
+			{ "a mov with nops as its immediate behind a prologue", with_prologue({ 0xB8, 0x90, 0x90, 0x90, 0x90 }), PROLOGUE.size(), std::unexpected(Error::UNKNOWN_INSTRUCTION) },
+			// `call $+5` ends in `add [rax], al` twice, but it is the only call
+			{ "a call with a zero displacement", { 0xE8, 0x00, 0x00, 0x00, 0x00 }, 3, 0 },
+			{ "a call with a zero displacement behind a prologue", with_prologue({ 0xE8, 0x00, 0x00, 0x00, 0x00 }), PROLOGUE.size(), PROLOGUE.size() },
+		};
+	}
+
+	std::string describe(const std::expected<std::size_t, Error>& offset)
+	{
+		return offset.has_value() ? std::format("offset {}", *offset) : std::format("error {}", std::to_underlying(offset.error()));
+	}
+
+	// The offset of the found instruction, which has to end where the bytes end
+	std::expected<std::size_t, Error> predecessor_offset(const std::expected<Predecessor, Error>& predecessor, std::size_t size)
+	{
+		if (!predecessor.has_value())
+			return std::unexpected(predecessor.error());
+		if (predecessor->offset + predecessor->instruction.length != size)
+			return std::unexpected(Error::NO_MORE_DATA);
+		return predecessor->offset;
+	}
+
+	// The matches of `patterns` in `bytes`, found by comparing every pattern at every offset
+	std::vector<Signature::Match> brute_force_scan(std::span<const Signature::Pattern> patterns, std::span<const std::byte> bytes)
+	{
+		std::vector<Signature::Match> matches;
+		for (std::size_t offset = 0; offset < bytes.size(); offset++) {
+			for (std::size_t pattern = 0; pattern < patterns.size(); pattern++) {
+				const std::size_t length = patterns[pattern].bytes.size();
+				if (length != 0 && length <= bytes.size() - offset && patterns[pattern].matches(bytes.subspan(offset)))
+					matches.push_back({ .pattern = pattern, .offset = offset });
+			}
+		}
+		return matches;
+	}
+
+	// The offsets of the code at which `pattern` matches, up to the first two
+	std::vector<std::size_t> find_pattern(const Signature::Pattern& pattern, std::span<const std::byte> code)
+	{
+		std::vector<std::size_t> offsets;
+		for (std::size_t offset = 0; offset + pattern.bytes.size() <= code.size() && offsets.size() < 2; offset++) {
+			if (pattern.matches(code.subspan(offset)))
+				offsets.push_back(offset);
+		}
+		return offsets;
+	}
+
+	// `generate` at `offset` has to return a pattern that matches only there, and whose prefix one byte shorter matches elsewhere
+	std::optional<std::string> check_generate(std::span<const std::byte> code, std::size_t offset, MachineMode mode)
+	{
+		const std::expected<Signature::Pattern, Signature::GenerateError> pattern = Signature::generate(code, offset, mode);
+		if (!pattern.has_value()) {
+			if (pattern.error() == Signature::GenerateError::UNDECODABLE)
+				return std::format("the instruction at {} couldn't be decoded", offset);
+			return std::nullopt;
+		}
+
+		if (find_pattern(*pattern, code) != std::vector{ offset })
+			return std::format("\"{}\" doesn't match only at {}", pattern->to_string(), offset);
+
+		Signature::Pattern prefix = *pattern;
+		prefix.bytes.pop_back();
+		prefix.mask.pop_back();
+		if (!prefix.bytes.empty() && find_pattern(prefix, code) == std::vector{ offset })
+			return std::format("\"{}\" at {} is longer than needed, \"{}\" is unique as well", pattern->to_string(), offset, prefix.to_string());
+
+		return std::nullopt;
+	}
+
+	// Patterns of the code around the first few 32 byte blocks, starting right before, at and right after their edges.
+	// Either all bytes are solid or the ones that end up at the edges of the blocks are wildcards, which moves the anchor.
+	std::vector<Signature::Pattern> edge_patterns(std::span<const std::byte> code)
+	{
+		constexpr std::size_t BLOCK_SIZE = 32;
+		constexpr std::array<std::size_t, 4> LENGTHS{ 1, 2, 3, 9 };
+
+		std::vector<Signature::Pattern> patterns{
+			Signature::Pattern{},
+			Signature::Pattern::parse("?? ??").value(),
+		};
+
+		for (std::size_t block = 1; block <= 4; block++) {
+			for (const std::size_t begin : { block * BLOCK_SIZE - 2, block * BLOCK_SIZE - 1, block * BLOCK_SIZE, block * BLOCK_SIZE + 1 }) {
+				for (const std::size_t length : LENGTHS) {
+					if (begin + length > code.size())
+						continue;
+
+					Signature::Pattern solid{
+						.bytes = { code.begin() + static_cast<std::ptrdiff_t>(begin), code.begin() + static_cast<std::ptrdiff_t>(begin + length) },
+						.mask = std::vector(length, std::byte{ 0xFF }),
+					};
+
+					Signature::Pattern edges = solid;
+					for (std::size_t i = 0; i < length; i++) {
+						if ((begin + i) % BLOCK_SIZE == 0 || (begin + i) % BLOCK_SIZE == BLOCK_SIZE - 1)
+							edges.mask[i] = std::byte{ 0x00 };
+					}
+
+					patterns.push_back(std::move(solid));
+					patterns.push_back(std::move(edges));
+				}
+			}
+		}
+
+		return patterns;
+	}
+
+	// What a patch did to the instructions around it, every kind has to be seen at least once
+	enum PatchKind : std::uint8_t {
+		SHORTENS, // The instruction at the patch is shorter than before
+		LENGTHENS, // The instruction at the patch is longer than before
+		STRADDLES, // The patch starts inside an instruction and covers the boundary after it
+		ENDS_WITH_CODE, // The patch ends where the code ends
+		RESYNCS_AFTER_PATCH, // A boundary changed behind the patch, so the decoder had to run past it
+		PATCH_KIND_COUNT,
+	};
+
+	constexpr std::array<std::string_view, PATCH_KIND_COUNT> PATCH_KIND_NAMES{
+		"shortens an instruction",
+		"lengthens an instruction",
+		"straddles a boundary",
+		"ends with the code",
+		"changes a boundary behind itself",
+	};
+
+	// The offset of the next boundary after `offset`, or the end of the code
+	std::size_t next_boundary(const BoundaryMap& map, std::size_t offset)
+	{
+		do
+			offset++;
+		while (offset < map.size() && !map.is_boundary(offset));
+		return offset;
+	}
+
+	// Patches `patched` at `offset` with `replacement` and checks the update against building the map again.
+	// Returns the kinds of the patch, which are only counted when the patched code could be decoded.
+	std::optional<std::string> check_patch(const BoundaryMap& original,
+		std::span<const std::byte> code,
+		std::size_t offset,
+		std::span<const std::byte> replacement,
+		std::array<bool, PATCH_KIND_COUNT>& seen)
+	{
+		std::vector<std::byte> patched{ code.begin(), code.end() };
+		std::ranges::copy(replacement, patched.begin() + static_cast<std::ptrdiff_t>(offset));
+		const std::size_t patch_end = offset + replacement.size();
+
+		BoundaryMap map = original;
+		const std::expected<BoundaryChanges, SweepError> changes = map.update(patched, offset, replacement.size());
+		const std::expected<BoundaryMap, SweepError> rebuilt = BoundaryMap::build(patched, original.mode());
+
+		if (!rebuilt.has_value()) {
+			// The map has to stay as it was, and fail at the same instruction as a full sweep
+			if (changes.has_value())
+				return std::format("patching {} bytes at {} succeeded, but the patched code fails at {}", replacement.size(), offset, rebuilt.error().offset);
+			if (changes.error().offset != rebuilt.error().offset || changes.error().error != rebuilt.error().error)
+				return std::format("patching {} bytes at {} failed at {} instead of at {}", replacement.size(), offset, changes.error().offset, rebuilt.error().offset);
+			if (map.count() != original.count())
+				return std::format("patching {} bytes at {} failed, but changed the map", replacement.size(), offset);
+			return std::nullopt;
+		}
+		if (!changes.has_value())
+			return std::format("patching {} bytes at {} failed at {}, but the patched code decodes", replacement.size(), offset, changes.error().offset);
+
+		// The changes have to be exactly the difference between the maps, and the map has to be the rebuilt one
+		std::vector<std::size_t> added;
+		std::vector<std::size_t> removed;
+		for (std::size_t i = 0; i < code.size(); i++) {
+			if (rebuilt->is_boundary(i) && !original.is_boundary(i))
+				added.push_back(i);
+			if (!rebuilt->is_boundary(i) && original.is_boundary(i))
+				removed.push_back(i);
+			if (map.is_boundary(i) != rebuilt->is_boundary(i))
+				return std::format("after patching {} bytes at {}, {} is {}a boundary", replacement.size(), offset, i, map.is_boundary(i) ? "" : "not ");
+		}
+		if (map.count() != rebuilt->count())
+			return std::format("after patching {} bytes at {}, the map has {} instead of {} instructions", replacement.size(), offset, map.count(), rebuilt->count());
+		if (changes->added != added || changes->removed != removed)
+			return std::format("patching {} bytes at {} reported {} added and {} removed boundaries instead of {} and {}",
+				replacement.size(),
+				offset,
+				changes->added.size(),
+				changes->removed.size(),
+				added.size(),
+				removed.size());
+		if (changes->begin > offset || changes->end < std::min(patch_end, code.size()))
+			return std::format("patching {} bytes at {} decoded only [{}, {})", replacement.size(), offset, changes->begin, changes->end);
+
+		const std::size_t start = original.instruction_start(offset);
+		if (start == offset && next_boundary(*rebuilt, offset) < next_boundary(original, offset))
+			seen[SHORTENS] = true;
+		if (start == offset && next_boundary(*rebuilt, offset) > next_boundary(original, offset))
+			seen[LENGTHENS] = true;
+		if (start != offset && next_boundary(original, offset) < patch_end)
+			seen[STRADDLES] = true;
+		if (patch_end == code.size())
+			seen[ENDS_WITH_CODE] = true;
+		if (std::ranges::any_of(added, [patch_end](std::size_t boundary) { return boundary > patch_end; }))
+			seen[RESYNCS_AFTER_PATCH] = true;
+
+		return std::nullopt;
+	}
+
+#if defined(__unix__)
+	constexpr std::array BUILD_ID{ std::byte{ 0x4C }, std::byte{ 0x44 }, std::byte{ 0x49 }, std::byte{ 0x4E }, std::byte{ 0x44 }, std::byte{ 0x45 }, std::byte{ 0x58 }, std::byte{ 0x01 } };
+	constexpr std::array OTHER_BUILD_ID{ std::byte{ 0x4C }, std::byte{ 0x44 }, std::byte{ 0x49 }, std::byte{ 0x4E }, std::byte{ 0x44 }, std::byte{ 0x45 }, std::byte{ 0x58 }, std::byte{ 0x02 } };
+
+	// The layout of an index file with a single word of build ID, see Source/Index.cpp
+	constexpr std::size_t FIRST_RANGE_HEADER = 5 + 1;
+	constexpr std::size_t RANGE_HEADER_WORDS = 4; // Address, size, offset of the bits and offset of the ranks
+
+	std::string describe(std::optional<std::uint64_t> address)
+	{
+		return address.has_value() ? std::format("{:#x}", *address) : "none";
+	}
+
+	// Every query of a range against the starts it has to know, which are relative to the range
+	std::optional<std::string> compare_range(const Index::RangeIndex& range, std::span<const std::size_t> starts)
+	{
+		if (range.count() != starts.size())
+			return std::format("the range at {:#x} has {} instead of {} instructions", range.address(), range.count(), starts.size());
+		if (range.select(starts.size()).has_value())
+			return std::format("the range at {:#x} selects an instruction past its last one", range.address());
+		if (range.address() != 0 && range.next_instruction_start(range.address() - 1) != range.select(0))
+			return std::format("the range at {:#x} doesn't start with its first instruction when asked from before it", range.address());
+
+		std::size_t rank = 0; // The amount of starts before `offset`
+		for (std::uint64_t offset = 0; offset <= range.size(); offset++) {
+			const std::uint64_t address = range.address() + offset;
+			const bool is_start = rank < starts.size() && starts[rank] == offset;
+
+			const std::optional<std::uint64_t> next = rank + is_start < starts.size() ? std::optional{ range.address() + starts[rank + is_start] } : std::nullopt;
+			const std::optional<std::uint64_t> previous = rank != 0 ? std::optional{ range.address() + starts[rank - 1] } : std::nullopt;
+
+			if (range.is_instruction_start(address) != is_start)
+				return std::format("{:#x} is {}an instruction start", address, is_start ? "not " : "");
+			if (range.rank(address) != rank)
+				return std::format("{:#x} has rank {} instead of {}", address, range.rank(address), rank);
+			if (range.next_instruction_start(address) != next)
+				return std::format("the start after {:#x} is {} instead of {}", address, describe(range.next_instruction_start(address)), describe(next));
+			if (range.previous_instruction_start(address) != previous)
+				return std::format("the start before {:#x} is {} instead of {}", address, describe(range.previous_instruction_start(address)), describe(previous));
+
+			if (is_start) {
+				if (range.select(rank) != address)
+					return std::format("start {} is {} instead of {:#x}", rank, describe(range.select(rank)), address);
+				rank++;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	// `ranges` is sorted by address, which is the order the index has to have as well
+	std::optional<std::string> compare_index(const Index::ModuleIndex& index,
+		MachineMode mode,
+		std::span<const Elf::CodeRange> ranges,
+		std::span<const std::vector<std::size_t>> starts)
+	{
+		if (index.mode() != mode)
+			return "the machine mode differs";
+		if (!std::ranges::equal(index.build_id(), BUILD_ID))
+			return "the build ID differs";
+		if (index.ranges().size() != ranges.size())
+			return std::format("{} instead of {} ranges", index.ranges().size(), ranges.size());
+
+		for (std::size_t i = 0; i < ranges.size(); i++) {
+			const Index::RangeIndex& range = index.ranges()[i];
+			if (range.address() != ranges[i].address || range.size() != ranges[i].bytes.size())
+				return std::format("range {} is at {:#x} with {} bytes instead of at {:#x} with {} bytes", i, range.address(), range.size(), ranges[i].address, ranges[i].bytes.size());
+
+			if (range.size() != 0 && (index.find(range.address()) != &range || index.find(range.address() + range.size() - 1) != &range))
+				return std::format("the addresses of range {} aren't found in it", i);
+			if (index.find(range.address() - 1) != nullptr || index.find(range.address() + range.size()) != nullptr)
+				return std::format("the addresses around range {} are found in a range", i);
+
+			if (std::optional<std::string> difference = compare_range(range, starts[i]))
+				return difference;
+		}
+
+		return std::nullopt;
+	}
+
+	std::string describe(Index::LoadError error)
+	{
+		switch (error) {
+		case Index::LoadError::OPEN_FAILED:
+			return "OPEN_FAILED";
+		case Index::LoadError::MAPPING_FAILED:
+			return "MAPPING_FAILED";
+		case Index::LoadError::NOT_AN_INDEX:
+			return "NOT_AN_INDEX";
+		case Index::LoadError::UNSUPPORTED_VERSION:
+			return "UNSUPPORTED_VERSION";
+		case Index::LoadError::BUILD_ID_MISMATCH:
+			return "BUILD_ID_MISMATCH";
+		case Index::LoadError::MALFORMED:
+			return "MALFORMED";
+		case Index::LoadError::MISSING_BUILD_ID:
+			return "MISSING_BUILD_ID";
+		default:
+			std::unreachable();
+		}
+	}
+
+	std::vector<std::uint64_t> read_words(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		std::vector<std::uint64_t> words(static_cast<std::size_t>(file.tellg()) / sizeof(std::uint64_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(std::uint64_t)));
+		return words;
+	}
+
+	void write_words(const std::string& path, std::span<const std::uint64_t> words)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(words.data()), static_cast<std::streamsize>(words.size_bytes()));
+	}
+
+	// Files that have to be rejected, each made from a valid index of two ranges
+	struct Corruption {
+		std::string_view name;
+		std::function<void(std::vector<std::uint64_t>&)> corrupt;
+		Index::LoadError error;
+	};
+
+	std::vector<Corruption> corruptions()
+	{
+		// The second range is never empty, its bits and ranks are corrupted
+		constexpr std::size_t SECOND_RANGE = FIRST_RANGE_HEADER + RANGE_HEADER_WORDS;
+
+		return {
+			{ "a wrong magic", [](std::vector<std::uint64_t>& words) { words[0] ^= 1; }, Index::LoadError::NOT_AN_INDEX },
+			{ "a newer version",
+				[](std::vector<std::uint64_t>& words) {
+					std::uint32_t version;
+					std::memcpy(&version, reinterpret_cast<const char*>(words.data()) + 8, sizeof(version));
+					version++;
+					std::memcpy(reinterpret_cast<char*>(words.data()) + 8, &version, sizeof(version));
+				},
+				Index::LoadError::UNSUPPORTED_VERSION },
+			{ "a missing last word", [](std::vector<std::uint64_t>& words) { words.pop_back(); }, Index::LoadError::MALFORMED },
+			{ "a range larger than the file", [](std::vector<std::uint64_t>& words) { words[SECOND_RANGE + 1] = ~std::uint64_t{ 0 }; }, Index::LoadError::MALFORMED },
+			{ "bits past the end of the file", [](std::vector<std::uint64_t>& words) { words[SECOND_RANGE + 2] = words.size(); }, Index::LoadError::MALFORMED },
+			{ "a flipped bit", [](std::vector<std::uint64_t>& words) { words[words[SECOND_RANGE + 2]] ^= 1; }, Index::LoadError::MALFORMED },
+			{ "a count that doesn't start at 0", [](std::vector<std::uint64_t>& words) { words[words[SECOND_RANGE + 3]] = 1; }, Index::LoadError::MALFORMED },
+			{ "a count that is off by one", [](std::vector<std::uint64_t>& words) { words[words[SECOND_RANGE + 3] + 1] += 1; }, Index::LoadError::MALFORMED },
+		};
+	}
+#endif
+}
+
+void Components::check_sweep(const Code& code, std::vector<std::string>& failures)
+{
+	std::vector<std::uint8_t> lengths(code.starts.size());
+	const std::expected<SweepResult, SweepError> result = sweep(code.bytes, lengths, code.mode);
+	if (!result.has_value() || result->count != code.starts.size()) {
+		failures.push_back(std::format("{}-bit sweep over {} instructions: {}", bits_of(code.mode), code.starts.size(), describe(result)));
+	} else {
+		for (std::size_t i = 0; i < code.starts.size(); i++) {
+			const std::size_t end = i + 1 == code.starts.size() ? code.bytes.size() : code.starts[i + 1];
+			if (code.starts[i] + lengths[i] != end) {
+				failures.push_back(std::format("{}-bit sweep takes the instruction at offset {} as {} bytes instead of {}", bits_of(code.mode), code.starts[i], lengths[i], end - code.starts[i]));
+				break;
+			}
+		}
+	}
+
+	for (const std::vector<std::byte>& input : sweep_inputs(code)) {
+		std::vector<std::uint8_t> expected_lengths(input.size());
+		std::vector<Instruction> instructions(input.size());
+		const std::expected<SweepResult, SweepError> expected = sweep(input, expected_lengths, instructions, code.mode);
+
+		std::vector<std::uint8_t> actual_lengths(input.size());
+		const std::expected<SweepResult, SweepError> actual = sweep(input, actual_lengths, code.mode);
+
+		if (const std::optional<std::string> difference = compare_sweeps(expected, expected_lengths, actual, actual_lengths))
+			failures.push_back(std::format("{}-bit sweep over {} bytes without instructions: {}", bits_of(code.mode), input.size(), *difference));
+	}
+
+	std::optional<std::string> difference;
+	switch (code.mode) {
+	case MachineMode::VIRTUAL8086:
+		difference = compare_shortcut<MachineMode::VIRTUAL8086>();
+		break;
+	case MachineMode::LONG_COMPATIBILITY_MODE:
+		difference = compare_shortcut<MachineMode::LONG_COMPATIBILITY_MODE>();
+		break;
+	case MachineMode::LONG_MODE:
+		difference = compare_shortcut<MachineMode::LONG_MODE>();
+		break;
+	default:
+		std::unreachable();
+	}
+	if (difference.has_value())
+		failures.push_back(std::format("{}-bit sweep: {}", bits_of(code.mode), *difference));
+}
+
+void Components::check_parallel_sweep(const Code& code, std::vector<std::string>& failures)
+{
+	constexpr std::array THREADS{ 1U, 2U, 3U, 8U };
+	// Chunks of a single byte and of less than an instruction start nearly every speculative stream in the middle of an instruction
+	constexpr std::array<std::size_t, 4> CHUNK_SIZES{ 1, 7, 256, 64 * 1024 };
+
+	for (const std::vector<std::byte>& input : sweep_inputs(code)) {
+		// A full buffer, and ones that fill up before the end, which has to stop the stitching in the middle of a chunk
+		const std::array<std::size_t, 3> capacities{ input.size(), code.starts.size() / 3, 1 };
+
+		for (const std::size_t capacity : capacities) {
+			std::vector<std::uint8_t> expected_lengths(capacity);
+			const std::expected<SweepResult, SweepError> expected = sweep(input, expected_lengths, code.mode);
+
+			std::vector<std::uint8_t> expected_skipping_lengths(capacity);
+			const SweepResult expected_skipping = sweep_skipping(input, expected_skipping_lengths, code.mode);
+
+			for (const unsigned threads : THREADS) {
+				for (const std::size_t chunk_size : CHUNK_SIZES) {
+					std::vector<std::uint8_t> lengths(capacity);
+					const std::expected<SweepResult, SweepError> actual = Detail::parallel_sweep(input, lengths, code.mode, threads, { .min_chunk_size = chunk_size });
+
+					if (const std::optional<std::string> difference = compare_sweeps(expected, expected_lengths, actual, lengths)) {
+						failures.push_back(std::format("{}-bit parallel_sweep over {} bytes into {} lengths with {} threads and {} byte chunks: {}",
+							bits_of(code.mode),
+							input.size(),
+							capacity,
+							threads,
+							chunk_size,
+							*difference));
+					}
+
+					std::vector<std::uint8_t> skipping_lengths(capacity);
+					const SweepResult skipping = Detail::parallel_sweep_skipping(input, skipping_lengths, code.mode, threads, { .min_chunk_size = chunk_size });
+					if (const std::optional<std::string> difference = compare_sweeps(expected_skipping, expected_skipping_lengths, skipping, skipping_lengths)) {
+						failures.push_back(std::format("{}-bit parallel_sweep_skipping over {} bytes into {} lengths with {} threads and {} byte chunks: {}",
+							bits_of(code.mode),
+							input.size(),
+							capacity,
+							threads,
+							chunk_size,
+							*difference));
+					}
+				}
+			}
+		}
+	}
+}
+
+void Components::check_stream_decoder(const Code& code, std::vector<std::string>& failures)
+{
+	// Single bytes, pieces that cut most instructions and the longest instruction
+	constexpr std::array<std::size_t, 3> PIECE_SIZES{ 1, 7, MAX_INSTRUCTION_LENGTH };
+	// Hardly any room forces the decoder to hold back the rest of a piece
+	constexpr std::array<std::size_t, 2> CAPACITIES{ 3, 4096 };
+
+	for (const std::vector<std::byte>& input : sweep_inputs(code)) {
+		for (const std::size_t piece_size : PIECE_SIZES) {
+			for (const std::size_t capacity : CAPACITIES) {
+				if (std::optional<std::string> difference = compare_stream(input, code.mode, piece_size, capacity)) {
+					failures.push_back(std::format("{}-bit StreamDecoder over {} bytes in {} byte pieces with room for {} lengths: {}",
+						bits_of(code.mode),
+						input.size(),
+						piece_size,
+						capacity,
+						*difference));
+				}
+			}
+		}
+	}
+}
+
+void Components::check_find_predecessor(const Code& code, std::vector<std::string>& failures)
+{
+	// Out of the instructions that have a full window in front of them, or the start of the buffer, as many have to be found.
+	// The rust-analyzer corpus gets all of them, the imported ones are test cases back to back rather than real code.
+	constexpr double MIN_ACCURACY = 0.95;
+	constexpr std::size_t STRIDE = 7;
+
+	if (code.mode == MachineMode::LONG_MODE) {
+		for (const PredecessorCase& test : predecessor_cases()) {
+			const std::span<const std::byte> bytes = std::as_bytes(std::span{ test.bytes });
+
+			const std::expected<std::size_t, Error> predecessor = predecessor_offset(find_predecessor(bytes, code.mode), bytes.size());
+			if (predecessor != test.predecessor)
+				failures.push_back(std::format("find_predecessor of {}: expected {}, got {}", test.name, describe(test.predecessor), describe(predecessor)));
+
+			const std::expected<std::size_t, Error> call_site = predecessor_offset(find_call_site(bytes, code.mode), bytes.size());
+			if (call_site != test.call_site)
+				failures.push_back(std::format("find_call_site of {}: expected {}, got {}", test.name, describe(test.call_site), describe(call_site)));
+		}
+	}
+
+	// Every few instructions, and all of the first ones, whose windows are cut off by the start of the buffer
+	std::size_t found = 0;
+	std::size_t checked = 0;
+	for (std::size_t i = 0; i + 1 < code.starts.size(); i += i < MAX_BACKWARD_WINDOW / MAX_INSTRUCTION_LENGTH ? 1 : STRIDE) {
+		const std::size_t end = code.starts[i + 1];
+		const std::size_t begin = end - std::min(end, MAX_BACKWARD_WINDOW);
+		const std::span<const std::byte> bytes = std::span{ code.bytes }.subspan(begin, end - begin);
+
+		const std::expected<std::size_t, Error> predecessor = predecessor_offset(find_predecessor(bytes, code.mode), bytes.size());
+		if (!predecessor.has_value() && predecessor.error() == Error::NO_MORE_DATA) {
+			failures.push_back(std::format("{}-bit find_predecessor before {} found an instruction that doesn't end there", bits_of(code.mode), end));
+			return;
+		}
+
+		checked++;
+		if (predecessor.has_value() && begin + *predecessor == code.starts[i])
+			found++;
+	}
+
+	if (static_cast<double>(found) < MIN_ACCURACY * static_cast<double>(checked))
+		failures.push_back(std::format("{}-bit find_predecessor found only {} of {} instructions", bits_of(code.mode), found, checked));
+}
+
+void Components::check_signatures(const Code& code, std::vector<std::string>& failures)
+{
+	// Generating and scanning by brute force are quadratic, a few KiB of code suffice
+	constexpr std::size_t GENERATE_SIZE = 16 * 1024;
+	constexpr std::size_t SCAN_SIZE = 4 * 1024;
+	constexpr std::size_t SAMPLES = 64;
+
+	// `mov eax, 1; mov eax, 2`, the first instruction is unique after two of its bytes
+	if (code.mode == MachineMode::LONG_MODE) {
+		constexpr std::array<std::uint8_t, 10> TWO_MOVS{ 0xB8, 0x01, 0x00, 0x00, 0x00, 0xB8, 0x02, 0x00, 0x00, 0x00 };
+		const std::expected<Signature::Pattern, Signature::GenerateError> pattern = Signature::generate(std::as_bytes(std::span{ TWO_MOVS }), 0);
+		if (!pattern.has_value() || pattern->to_string() != "B8 01")
+			failures.push_back(std::format("generate of two movs: expected \"B8 01\", got \"{}\"", pattern.has_value() ? pattern->to_string() : "an error"));
+	}
+
+	const std::size_t generate_end = std::ranges::upper_bound(code.starts, GENERATE_SIZE) - code.starts.begin();
+	const std::span<const std::byte> generate_code = std::span{ code.bytes }.first(generate_end == code.starts.size() ? code.bytes.size() : code.starts[generate_end]);
+	for (std::size_t sample = 0; sample < SAMPLES && generate_end != 0; sample++) {
+		const std::size_t offset = code.starts[sample * generate_end / SAMPLES];
+		if (std::optional<std::string> failure = check_generate(generate_code, offset, code.mode))
+			failures.push_back(std::format("{}-bit generate: {}", bits_of(code.mode), *failure));
+	}
+
+	const std::span<const std::byte> scan_code = std::span{ code.bytes }.first(std::min(code.bytes.size(), SCAN_SIZE));
+	const std::vector<Signature::Pattern> patterns = edge_patterns(scan_code);
+	const Signature::Scanner scanner{ patterns };
+
+	// The vectorized scan leaves the last few bytes to the scalar one, so every end within a block has to work, and every alignment
+	std::vector<std::span<const std::byte>> buffers;
+	for (std::size_t size = 0; size <= std::min<std::size_t>(scan_code.size(), 70); size++)
+		buffers.push_back(scan_code.first(size));
+	for (std::size_t cut = 1; cut <= std::min<std::size_t>(scan_code.size(), 33); cut++)
+		buffers.push_back(scan_code.first(scan_code.size() - cut));
+	for (std::size_t skip = 1; skip <= std::min<std::size_t>(scan_code.size(), 31); skip++)
+		buffers.push_back(scan_code.subspan(skip));
+
+	for (const std::span<const std::byte> buffer : buffers) {
+		const std::vector<Signature::Match> expected = brute_force_scan(patterns, buffer);
+		const std::vector<Signature::Match> scalar = Detail::ScannerPaths::scan_scalar(scanner, buffer);
+		const std::vector<Signature::Match> vectorized = Detail::ScannerPaths::scan_vectorized(scanner, buffer);
+
+		if (scalar != expected || vectorized != expected) {
+			failures.push_back(std::format("{}-bit Scanner over {} bytes at {}: {} matches expected, the scalar scan found {} and the vectorized one {}",
+				bits_of(code.mode),
+				buffer.size(),
+				buffer.data() - scan_code.data(),
+				expected.size(),
+				scalar.size(),
+				vectorized.size()));
+			return;
+		}
+	}
+}
+
+void Components::check_boundaries(const Code& code, std::vector<std::string>& failures)
+{
+	// The patches are checked against building the whole map again, so a few thousand instructions are enough
+	constexpr std::size_t INSTRUCTIONS = 4096;
+	constexpr std::size_t POSITIONS = 48;
+
+	// Too little code to find every kind of patch in
+	if (code.starts.size() < 64)
+		return;
+
+	const std::size_t instructions = std::min(code.starts.size(), INSTRUCTIONS);
+	const std::size_t size = instructions == code.starts.size() ? code.bytes.size() : code.starts[instructions];
+	const std::span<const std::byte> region = std::span{ code.bytes }.first(size);
+
+	const std::expected<BoundaryMap, SweepError> map = BoundaryMap::build(region, code.mode);
+	if (!map.has_value() || map->count() != instructions) {
+		failures.push_back(std::format("{}-bit BoundaryMap doesn't find the {} instructions of the code", bits_of(code.mode), instructions));
+		return;
+	}
+
+	// The first instruction of every length, as the replacements
+	std::array<std::span<const std::byte>, MAX_INSTRUCTION_LENGTH + 1> replacements{};
+	for (std::size_t i = 0; i < instructions; i++) {
+		const std::size_t end = i + 1 == instructions ? size : code.starts[i + 1];
+		std::span<const std::byte>& replacement = replacements[end - code.starts[i]];
+		if (replacement.empty())
+			replacement = region.subspan(code.starts[i], end - code.starts[i]);
+	}
+
+	std::array<bool, PATCH_KIND_COUNT> seen{};
+	const auto check = [&](std::size_t offset, std::span<const std::byte> replacement) {
+		if (replacement.empty() || offset + replacement.size() > size)
+			return true;
+
+		if (std::optional<std::string> failure = check_patch(*map, region, offset, replacement, seen)) {
+			failures.push_back(std::format("{}-bit BoundaryMap: {}", bits_of(code.mode), *failure));
+			return false;
+		}
+		return true;
+	};
+
+	// At and just after instruction starts spread over the code, and over its last bytes
+	for (std::size_t position = 0; position < POSITIONS; position++) {
+		const std::size_t start = code.starts[position * instructions / POSITIONS];
+		for (const std::span<const std::byte> replacement : replacements) {
+			if (!check(start, replacement) || !check(start + 1, replacement) || !check(size - replacement.size(), replacement))
+				return;
+		}
+	}
+
+	for (std::size_t kind = 0; kind < PATCH_KIND_COUNT; kind++) {
+		if (!seen[kind])
+			failures.push_back(std::format("{}-bit BoundaryMap: no patch that {} could be decoded", bits_of(code.mode), PATCH_KIND_NAMES[kind]));
+	}
+}
+
+void Components::check_index(const Code& code, std::vector<std::string>& failures)
+{
+#if defined(__unix__)
+	const auto failed = [&](std::string_view what) { failures.push_back(std::format("{}-bit index: {}", bits_of(code.mode), what)); };
+
+	// Two ranges that are split at an instruction start, handed to the index in reverse, and their starts relative to them
+	const std::size_t split = code.starts[code.starts.size() / 2];
+	const std::array ranges{
+		Elf::CodeRange{ .name = ".text", .address = 0x1000, .bytes = std::span{ code.bytes }.first(split) },
+		Elf::CodeRange{ .name = ".text.hot", .address = 0x40'0000, .bytes = std::span{ code.bytes }.subspan(split) },
+	};
+	std::array<std::vector<std::size_t>, 2> starts;
+	for (const std::size_t start : code.starts) {
+		if (start < split)
+			starts[0].push_back(start);
+		else
+			starts[1].push_back(start - split);
+	}
+
+	const std::array reversed{ ranges[1], ranges[0] };
+	std::expected<Index::ModuleIndex, Index::LoadError> index = Index::ModuleIndex::build(reversed, code.mode, BUILD_ID, 3);
+	if (!index.has_value())
+		return failed(std::format("building failed with {}", describe(index.error())));
+	if (std::optional<std::string> difference = compare_index(*index, code.mode, ranges, starts))
+		return failed(std::format("the built index is wrong: {}", *difference));
+
+	if (const auto unnamed = Index::ModuleIndex::build(ranges, code.mode, {}); unnamed.has_value() || unnamed.error() != Index::LoadError::MISSING_BUILD_ID)
+		failed("an index was built without a build ID");
+
+	std::string directory = (std::filesystem::temp_directory_path() / "LengthDisassemblerVerifier.XXXXXX").string();
+	if (::mkdtemp(directory.data()) == nullptr)
+		return failed(std::format("couldn't create a temporary directory: {}", std::strerror(errno)));
+
+	// Concurrent saves of the same index must not write into each other's files
+	const std::string path = Index::ModuleIndex::path_for(directory, BUILD_ID);
+	std::atomic<std::size_t> failed_saves = 0;
+	{
+		std::vector<std::jthread> savers;
+		for (int i = 0; i < 4; i++) {
+			savers.emplace_back([&] {
+				for (int j = 0; j < 8; j++) {
+					if (!index->save(path.c_str()).has_value())
+						failed_saves++;
+				}
+			});
+		}
+	}
+	if (failed_saves != 0)
+		failed(std::format("{} saves failed", failed_saves.load()));
+
+	if (const auto opened = Index::ModuleIndex::open(path.c_str(), BUILD_ID); !opened.has_value())
+		failed(std::format("opening the saved index failed with {}", describe(opened.error())));
+	else if (std::optional<std::string> difference = compare_index(*opened, code.mode, ranges, starts))
+		failed(std::format("the opened index is wrong: {}", *difference));
+
+	if (const auto opened = Index::ModuleIndex::open(path.c_str(), OTHER_BUILD_ID); opened.has_value() || opened.error() != Index::LoadError::BUILD_ID_MISMATCH)
+		failed("the index of another build was opened");
+	if (const auto opened = Index::ModuleIndex::open(path.c_str(), {}); opened.has_value() || opened.error() != Index::LoadError::MISSING_BUILD_ID)
+		failed("an index was opened without a build ID");
+
+	const std::vector<std::uint64_t> words = read_words(path);
+	const std::string corrupt_path = directory + "/corrupt.index";
+	for (const Corruption& corruption : corruptions()) {
+		std::vector<std::uint64_t> corrupt = words;
+		corruption.corrupt(corrupt);
+		write_words(corrupt_path, corrupt);
+
+		const auto opened = Index::ModuleIndex::open(corrupt_path.c_str(), BUILD_ID);
+		if (opened.has_value())
+			failed(std::format("an index with {} was opened", corruption.name));
+		else if (opened.error() != corruption.error)
+			failed(std::format("an index with {} was rejected with {} instead of {}", corruption.name, describe(opened.error()), describe(corruption.error)));
+	}
+
+	std::filesystem::remove_all(directory);
+#else
+	static_cast<void>(code);
+	static_cast<void>(failures);
+#endif
+}
@@ -0,0 +1,51 @@
+#ifndef LENGTHDISASSEMBLERVERIFIER_COMPONENTS_HPP
+#define LENGTHDISASSEMBLERVERIFIER_COMPONENTS_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+// Checks of everything that is built on top of the decoder, against the plain `sweep` and the boundaries of the corpus.
+// Every check appends a message per failure.
+namespace Components {
+	// Instructions of a single machine mode back to back, each of them decodes to exactly its test case
+	struct Code {
+		LengthDisassembler::MachineMode mode;
+		std::vector<std::byte> bytes;
+		std::vector<std::size_t> starts;
+	};
+
+	// `sweep` has to find every instruction of the code and return the same with and without instructions to fill in, as only the latter
+	// always runs the decoder. The shortcut that the former takes has to agree with the decoder behind every combination of prefixes,
+	// escape byte, opcode, ModRM and SIB byte that it knows.
+	void check_sweep(const Code& code, std::vector<std::string>& failures);
+
+	// `parallel_sweep` has to return the same as `sweep` for any amount of threads and chunks, also when it fails in a later chunk,
+	// and `parallel_sweep_skipping` the same as resuming `sweep` one byte after every error
+	void check_parallel_sweep(const Code& code, std::vector<std::string>& failures);
+
+	// `StreamDecoder` has to decode the same as a single `sweep`, whichever pieces the code arrives in and however few lengths are passed
+	void check_stream_decoder(const Code& code, std::vector<std::string>& failures);
+
+	// `find_predecessor` and `find_call_site` have to pick the instructions of hand-made cases, including ambiguous tails that only
+	// resolve with code in front of them and the start of the buffer, and nearly every instruction of the code from the bytes before its end
+	void check_find_predecessor(const Code& code, std::vector<std::string>& failures);
+
+	// `Signature::generate` has to stop at the shortest prefix that is unique, also within the first instruction,
+	// and the scalar and the AVX2 scan of a `Signature::Scanner` have to find every match, also of wildcards at the edges of 32 byte blocks
+	void check_signatures(const Code& code, std::vector<std::string>& failures);
+
+	// `BoundaryMap::update` has to leave the map as building it from the patched code would, and report exactly the boundaries that changed.
+	// The patches overwrite code with instructions of the corpus, so that some of them shorten or lengthen an instruction, straddle a
+	// boundary, end with the code, or make the decoder run past their end before it meets the old boundaries again.
+	void check_boundaries(const Code& code, std::vector<std::string>& failures);
+
+	// A `ModuleIndex` of the code has to know every start, before and after a round trip through a file,
+	// and `open` has to reject files that are cut off, corrupted or of a different build.
+	// NOTE: Only checks anything where the index is built, i.e. on Unix.
+	void check_index(const Code& code, std::vector<std::string>& failures);
+}
+
+#endif
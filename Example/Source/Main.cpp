@@ -1,91 +1,465 @@
 #include "LengthDisassembler/LengthDisassembler.hpp"
+#include "LengthDisassembler/Detail/Decoder.hpp"
 
-#include <cassert>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <expected>
+#include <format>
+#include <fstream>
 #include <iostream>
-#include <numeric>
+#include <iterator>
+#include <map>
+#include <optional>
 #include <print>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "Components.hpp"
+
 #include <Zycore/Status.h>
-#include <Zydis/Disassembler.h>
+#include <Zydis/Decoder.h>
 #include <Zydis/SharedTypes.h>
 
 using namespace LengthDisassembler;
 
-int main(int argc, const char** argv)
-{
-	assert(argc == 2);
+namespace {
+	// A packed corpus is the magic followed by one record per test case: the bitness (16, 32 or 64), the amount of bytes and the bytes themselves.
+	// Packing happens once at build time, so that verifying doesn't have to parse any text.
+	constexpr std::string_view CORPUS_MAGIC = "LDVC";
+
+	constexpr std::size_t CASES_PER_BATCH = 1024; // The amount of test cases a thread takes at once
+	constexpr std::size_t EXAMPLES_PER_GROUP = 4; // The amount of mismatches that are printed for every opcode
+
+	struct TestCase {
+		MachineMode mode;
+		std::span<const std::byte> bytes;
+	};
+
+	struct Corpus {
+		std::vector<std::vector<std::byte>> files; // The test cases point into these
+		std::vector<TestCase> cases;
+	};
 
-	using enum LengthDisassembler::MachineMode;
+	std::optional<MachineMode> mode_of(int bits)
+	{
+		switch (bits) {
+		case 16:
+			return MachineMode::VIRTUAL8086;
+		case 32:
+			return MachineMode::LONG_COMPATIBILITY_MODE;
+		case 64:
+			return MachineMode::LONG_MODE;
+		default:
+			return std::nullopt;
+		}
+	}
 
-	MachineMode mode = LONG_MODE;
-	if (strcmp(argv[1], "16") == 0) {
-		mode = VIRTUAL8086;
-	} else if (strcmp(argv[1], "32") == 0) {
-		mode = LONG_COMPATIBILITY_MODE;
-	} else if (strcmp(argv[1], "64") == 0) {
-		mode = LONG_MODE;
-	} else {
-		std::println(std::cerr, "Expected 16/32/64 bit as argv[1], got '{}'", argv[1]);
-		return 1;
+	constexpr int bits_of(MachineMode mode)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return 16;
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return 32;
+		case MachineMode::LONG_MODE:
+			return 64;
+		default:
+			std::unreachable();
+		}
 	}
 
-	ZydisMachineMode zydis_mode = ZYDIS_MACHINE_MODE_LONG_64;
-	switch (mode) {
-	case MachineMode::VIRTUAL8086:
-		zydis_mode = ZYDIS_MACHINE_MODE_REAL_16;
-		break;
-	case MachineMode::LONG_COMPATIBILITY_MODE:
-		zydis_mode = ZYDIS_MACHINE_MODE_LONG_COMPAT_32;
-		break;
-	case MachineMode::LONG_MODE:
-		zydis_mode = ZYDIS_MACHINE_MODE_LONG_64;
-		break;
+	std::optional<std::vector<std::byte>> read_file(const char* path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+			return std::nullopt;
+
+		std::vector<std::byte> contents;
+		for (char buffer[1 << 16]; file.read(buffer, sizeof(buffer)) || file.gcount() > 0;) {
+			const auto* begin = reinterpret_cast<const std::byte*>(buffer);
+			contents.insert(contents.end(), begin, begin + file.gcount());
+		}
+		return contents;
 	}
 
-	int failed_tests = 0;
+	constexpr std::optional<std::uint8_t> nibble_of(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return std::nullopt;
+	}
+
+	// Appends the records of a text corpus, which has one instruction per line as hex digits. Empty lines and lines starting with '#' are skipped.
+	bool pack_text_corpus(const char* path, int bits, std::vector<std::byte>& packed)
+	{
+		std::ifstream file{ path };
+		if (!file) {
+			std::println(std::cerr, "{}: Failed to open file ({})", path, std::strerror(errno));
+			return false;
+		}
+
+		std::size_t line_number = 0;
+		for (std::string line; std::getline(file, line);) {
+			line_number++;
+			while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+				line.pop_back();
+			if (line.empty() || line.front() == '#')
+				continue;
+
+			if (line.size() % 2 != 0 || line.size() / 2 > 0xFF) {
+				std::println(std::cerr, "{}:{}: Expected up to 255 bytes as pairs of hex digits", path, line_number);
+				return false;
+			}
+
+			packed.push_back(static_cast<std::byte>(bits));
+			packed.push_back(static_cast<std::byte>(line.size() / 2));
+			for (std::size_t i = 0; i < line.size(); i += 2) {
+				const std::optional<std::uint8_t> high = nibble_of(line[i]);
+				const std::optional<std::uint8_t> low = nibble_of(line[i + 1]);
+				if (!high.has_value() || !low.has_value()) {
+					std::println(std::cerr, "{}:{}: Expected hex digits, got '{}'", path, line_number, line.substr(i, 2));
+					return false;
+				}
+				packed.push_back(static_cast<std::byte>(high.value() << 4 | low.value()));
+			}
+		}
+
+		return true;
+	}
+
+	// Usage: pack <output> <bits>:<text corpus>...
+	int pack(std::span<const char*> arguments)
+	{
+		if (arguments.size() < 2) {
+			std::println(std::cerr, "Expected an output file and at least one <bits>:<text corpus>");
+			return 1;
+		}
+
+		std::vector<std::byte> packed;
+		for (const char c : CORPUS_MAGIC)
+			packed.push_back(static_cast<std::byte>(c));
 
-	for (std::string hex_string; std::getline(std::cin, hex_string);) {
-		std::vector<std::byte> nibbles;
+		for (const char* argument : arguments.subspan(1)) {
+			const char* separator = std::strchr(argument, ':');
+			const std::optional<MachineMode> mode = separator ? mode_of(std::atoi(argument)) : std::nullopt;
+			if (!mode.has_value()) {
+				std::println(std::cerr, "Expected 16/32/64 bit before the text corpus, got '{}'", argument);
+				return 1;
+			}
 
-		for (std::size_t i = 0; i < hex_string.length(); i += 2) {
-			const std::string hex_number{ hex_string.substr(i, 2) };
-			int b = std::stoi(hex_number, nullptr, 16);
-			nibbles.push_back(static_cast<std::byte>(b));
+			if (!pack_text_corpus(separator + 1, bits_of(mode.value()), packed))
+				return 1;
 		}
 
-		ZydisDisassembledInstruction instruction;
-		if (!ZYAN_SUCCESS(ZydisDisassembleIntel(zydis_mode,
-				0,
-				nibbles.data(),
-				nibbles.size(),
-				&instruction))) {
-			continue;
+		std::ofstream file{ arguments[0], std::ios::binary };
+		file.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packed.size()));
+		if (!file) {
+			std::println(std::cerr, "{}: Failed to write file", arguments[0]);
+			return 1;
 		}
 
-		std::expected<Instruction, Error> result = disassemble(nibbles.data(), mode, nibbles.size());
+		return 0;
+	}
+
+	bool load_corpus(const char* path, Corpus& corpus)
+	{
+		std::optional<std::vector<std::byte>> contents = read_file(path);
+		if (!contents.has_value()) {
+			std::println(std::cerr, "{}: Failed to open file ({})", path, std::strerror(errno));
+			return false;
+		}
+
+		const std::span<const std::byte> bytes = corpus.files.emplace_back(std::move(contents.value()));
+		if (bytes.size() < CORPUS_MAGIC.size() || std::memcmp(bytes.data(), CORPUS_MAGIC.data(), CORPUS_MAGIC.size()) != 0) {
+			std::println(std::cerr, "{}: Not a packed corpus", path);
+			return false;
+		}
+
+		for (std::size_t offset = CORPUS_MAGIC.size(); offset != bytes.size();) {
+			const std::optional<MachineMode> mode = mode_of(std::to_integer<int>(bytes[offset]));
+			if (!mode.has_value() || bytes.size() - offset < 2 || bytes.size() - offset - 2 < std::to_integer<std::size_t>(bytes[offset + 1])) {
+				std::println(std::cerr, "{}: Malformed record at offset {}", path, offset);
+				return false;
+			}
 
-		if (!result.has_value()) {
-			std::println(std::cerr, "Disassembly of '{}' failed with error: {}", hex_string, std::to_underlying(result.error()));
-			failed_tests = std::add_sat(failed_tests, 1);
-			continue;
+			const auto length = std::to_integer<std::size_t>(bytes[offset + 1]);
+			corpus.cases.push_back({ .mode = mode.value(), .bytes = bytes.subspan(offset + 2, length) });
+			offset += 2 + length;
 		}
 
-		std::uint8_t guess = result.value().length;
+		return true;
+	}
+
+	template <MachineMode Mode>
+	std::expected<Instruction, Error> decode(const std::byte* bytes, std::uint8_t max_length, std::size_t readable)
+	{
+		return Detail::decode<Mode>(bytes, max_length, readable);
+	}
+
+	// The decoder skips its bounds checks when enough bytes are readable, which must not change any result.
+	// Compares both paths on every truncation of the instruction, so that running out of bytes is covered as well.
+	bool decodes_identically(std::span<const std::byte> bytes, MachineMode mode)
+	{
+		const std::size_t longest = std::min<std::size_t>(bytes.size(), MAX_INSTRUCTION_LENGTH);
+
+		std::array<std::byte, 2 * MAX_INSTRUCTION_LENGTH> padded{};
+		std::copy_n(bytes.begin(), longest, padded.begin());
+
+		auto decoder = decode<MachineMode::LONG_MODE>;
+		if (mode == MachineMode::VIRTUAL8086)
+			decoder = decode<MachineMode::VIRTUAL8086>;
+		else if (mode == MachineMode::LONG_COMPATIBILITY_MODE)
+			decoder = decode<MachineMode::LONG_COMPATIBILITY_MODE>;
 
-		if (guess != instruction.info.length) {
-			std::println(std::cerr, "Expected {} but got {} on {}", instruction.info.length, guess, hex_string);
-			failed_tests = std::add_sat(failed_tests, 1);
+		for (std::size_t length = 0; length <= longest; length++) {
+			const auto max_length = static_cast<std::uint8_t>(length);
+			if (decoder(padded.data(), max_length, padded.size()) != decoder(bytes.data(), max_length, max_length))
+				return false;
 		}
+		return true;
 	}
 
-	return failed_tests;
+	// Both decoders are compiled in, whichever one LENGTHDISASSEMBLER_STATE_MACHINE_DECODER selects, and have to agree on every truncation.
+	bool decoders_agree(std::span<const std::byte> bytes, MachineMode mode)
+	{
+		auto state_machine = Detail::StateMachine::decode<MachineMode::LONG_MODE>;
+		auto handwritten = Detail::decode_handwritten<MachineMode::LONG_MODE>;
+		if (mode == MachineMode::VIRTUAL8086) {
+			state_machine = Detail::StateMachine::decode<MachineMode::VIRTUAL8086>;
+			handwritten = Detail::decode_handwritten<MachineMode::VIRTUAL8086>;
+		} else if (mode == MachineMode::LONG_COMPATIBILITY_MODE) {
+			state_machine = Detail::StateMachine::decode<MachineMode::LONG_COMPATIBILITY_MODE>;
+			handwritten = Detail::decode_handwritten<MachineMode::LONG_COMPATIBILITY_MODE>;
+		}
+
+		for (std::size_t length = 0; length <= std::min<std::size_t>(bytes.size(), MAX_INSTRUCTION_LENGTH); length++) {
+			const auto max_length = static_cast<std::uint8_t>(length);
+			if (state_machine(bytes.data(), max_length, max_length) != handwritten(bytes.data(), max_length, max_length))
+				return false;
+		}
+		return true;
+	}
+
+	std::string hex_of(std::span<const std::byte> bytes)
+	{
+		std::string hex;
+		for (const std::byte b : bytes)
+			hex += std::format("{:02x}", std::to_integer<int>(b));
+		return hex;
+	}
+
+	// Mismatches are grouped by the opcode that Zydis sees, as they usually share a cause
+	struct Mismatch {
+		int bits;
+		ZydisOpcodeMap opcode_map;
+		std::uint8_t opcode;
+		std::string message;
+	};
+
+	struct Verification {
+		std::size_t verified = 0;
+		std::size_t unknown = 0; // Test cases that Zydis can't decode either, which are skipped
+		std::vector<Mismatch> mismatches;
+	};
+
+	class Verifier {
+	public:
+		Verifier()
+		{
+			// Decoders only hold their configuration, so they can be shared between threads
+			ZydisDecoderInit(&decoders[0], ZYDIS_MACHINE_MODE_REAL_16, ZYDIS_STACK_WIDTH_16);
+			ZydisDecoderInit(&decoders[1], ZYDIS_MACHINE_MODE_LONG_COMPAT_32, ZYDIS_STACK_WIDTH_32);
+			ZydisDecoderInit(&decoders[2], ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+		}
+
+		void verify(const TestCase& test_case, Verification& verification) const
+		{
+			ZydisDecodedInstruction expected;
+			if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&decoders[std::to_underlying(test_case.mode)], nullptr, test_case.bytes.data(), test_case.bytes.size(), &expected))) {
+				verification.unknown++;
+				return;
+			}
+			verification.verified++;
+
+			const auto mismatch = [&](std::string message) {
+				verification.mismatches.push_back({ .bits = bits_of(test_case.mode), .opcode_map = expected.opcode_map, .opcode = expected.opcode, .message = std::move(message) });
+			};
+
+			if (!decodes_identically(test_case.bytes, test_case.mode))
+				mismatch(std::format("Checked and unchecked decoding disagree on {}", hex_of(test_case.bytes)));
+
+			if (!decoders_agree(test_case.bytes, test_case.mode))
+				mismatch(std::format("The hand-written and the state machine decoder disagree on {}", hex_of(test_case.bytes)));
+
+			const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(test_case.bytes.size(), MAX_INSTRUCTION_LENGTH));
+			const std::expected<Instruction, Error> result = disassemble(test_case.bytes.data(), test_case.mode, max_length);
+			if (!result.has_value())
+				mismatch(std::format("Disassembly of '{}' failed with error: {}", hex_of(test_case.bytes), std::to_underlying(result.error())));
+			else if (result->length != expected.length)
+				mismatch(std::format("Expected {} but got {} on {}", expected.length, result->length, hex_of(test_case.bytes)));
+		}
+
+	private:
+		std::array<ZydisDecoder, 3> decoders; // Indexed by MachineMode
+	};
+
+	// Shards the test cases across the threads in batches, every thread collects its own results
+	Verification verify_all(std::span<const TestCase> cases, unsigned threads)
+	{
+		const Verifier verifier;
+
+		std::atomic<std::size_t> next_batch = 0;
+		std::vector<Verification> verifications(threads);
+		{
+			std::vector<std::jthread> workers;
+			for (Verification& verification : verifications) {
+				workers.emplace_back([&cases, &verifier, &next_batch, &verification] {
+					for (;;) {
+						const std::size_t begin = next_batch.fetch_add(CASES_PER_BATCH, std::memory_order_relaxed);
+						if (begin >= cases.size())
+							return;
+
+						for (const TestCase& test_case : cases.subspan(begin, std::min(CASES_PER_BATCH, cases.size() - begin)))
+							verifier.verify(test_case, verification);
+					}
+				});
+			}
+		}
+
+		Verification total;
+		for (Verification& verification : verifications) {
+			total.verified += verification.verified;
+			total.unknown += verification.unknown;
+			std::move(verification.mismatches.begin(), verification.mismatches.end(), std::back_inserter(total.mismatches));
+		}
+		return total;
+	}
+
+	std::string_view name_of(ZydisOpcodeMap opcode_map)
+	{
+		constexpr std::array NAMES{ "", "0F ", "0F 38 ", "0F 3A ", "MAP4 ", "MAP5 ", "MAP6 ", "MAP7 ", "0F 0F ", "XOP8 ", "XOP9 ", "XOPA " };
+		const auto index = static_cast<std::size_t>(opcode_map);
+		return index < NAMES.size() ? NAMES[index] : "? ";
+	}
+
+	void report(std::vector<Mismatch>& mismatches)
+	{
+		std::map<std::tuple<int, ZydisOpcodeMap, std::uint8_t>, std::vector<const Mismatch*>> groups;
+		for (const Mismatch& mismatch : mismatches)
+			groups[{ mismatch.bits, mismatch.opcode_map, mismatch.opcode }].push_back(&mismatch);
+
+		for (const auto& [key, group] : groups) {
+			const auto& [bits, opcode_map, opcode] = key;
+			std::println(std::cerr, "{}-bit {}{:02X}: {} mismatches", bits, name_of(opcode_map), opcode, group.size());
+			for (const Mismatch* mismatch : std::span{ group }.first(std::min(group.size(), EXAMPLES_PER_GROUP)))
+				std::println(std::cerr, "    {}", mismatch->message);
+		}
+	}
+
+	// The test cases that decode to exactly their bytes, back to back per machine mode, as the corpora hold real code
+	std::vector<Components::Code> collect_code(std::span<const TestCase> cases)
+	{
+		std::vector<Components::Code> code;
+		for (const MachineMode mode : { MachineMode::VIRTUAL8086, MachineMode::LONG_COMPATIBILITY_MODE, MachineMode::LONG_MODE })
+			code.push_back({ .mode = mode, .bytes = {}, .starts = {} });
+
+		for (const TestCase& test_case : cases) {
+			const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(test_case.bytes.size(), MAX_INSTRUCTION_LENGTH));
+			const std::expected<Instruction, Error> result = disassemble(test_case.bytes.data(), test_case.mode, max_length);
+			if (!result.has_value() || result->length != test_case.bytes.size())
+				continue;
+
+			Components::Code& target = code[std::to_underlying(test_case.mode)];
+			target.starts.push_back(target.bytes.size());
+			target.bytes.insert(target.bytes.end(), test_case.bytes.begin(), test_case.bytes.end());
+		}
+
+		std::erase_if(code, [](const Components::Code& c) { return c.starts.empty(); });
+		return code;
+	}
+
+	std::vector<std::string> check_components(std::span<const TestCase> cases)
+	{
+		std::vector<std::string> failures;
+		for (const Components::Code& code : collect_code(cases)) {
+			Components::check_sweep(code, failures);
+			Components::check_parallel_sweep(code, failures);
+			Components::check_stream_decoder(code, failures);
+			Components::check_find_predecessor(code, failures);
+			Components::check_signatures(code, failures);
+			Components::check_boundaries(code, failures);
+			Components::check_index(code, failures);
+		}
+		return failures;
+	}
+
+	// Usage: [--threads <count>] <packed corpus>...
+	int verify(std::span<const char*> arguments)
+	{
+		unsigned threads = std::max(std::thread::hardware_concurrency(), 1U);
+		if (arguments.size() >= 2 && std::strcmp(arguments[0], "--threads") == 0) {
+			threads = std::max(static_cast<unsigned>(std::strtoul(arguments[1], nullptr, 10)), 1U);
+			arguments = arguments.subspan(2);
+		}
+
+		if (arguments.empty()) {
+			std::println(std::cerr, "Expected at least one packed corpus");
+			return 1;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+
+		Corpus corpus;
+		for (const char* path : arguments)
+			if (!load_corpus(path, corpus))
+				return 1;
+
+		Verification verification = verify_all(corpus.cases, threads);
+		const std::vector<std::string> failures = check_components(corpus.cases);
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+		report(verification.mismatches);
+		for (const std::string& failure : failures)
+			std::println(std::cerr, "{}", failure);
+		std::println("Verified {} test cases ({} unknown to Zydis were skipped) on {} threads in {} ms, {} mismatches, {} component failures",
+			verification.verified,
+			verification.unknown,
+			threads,
+			elapsed.count(),
+			verification.mismatches.size(),
+			failures.size());
+
+		return verification.mismatches.empty() && failures.empty() ? 0 : 1;
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	const std::span<const char*> arguments{ argv + 1, static_cast<std::size_t>(argc - 1) };
+
+	if (!arguments.empty() && std::strcmp(arguments[0], "pack") == 0)
+		return pack(arguments.subspan(1));
+	if (!arguments.empty())
+		return verify(arguments);
+
+	std::println(std::cerr, "Usage: {} pack <output> <bits>:<text corpus>...", argv[0]);
+	std::println(std::cerr, "       {} [--threads <count>] <packed corpus>...", argv[0]);
+	return 1;
 }
@@ -0,0 +1,53 @@
+#!/bin/bash
+#
+# Imports the test sets of other projects into this directory, or into the one given as the first argument.
+# Run it once to vendor them and the verifier then works offline, otherwise Example/CMakeLists.txt runs it into the build directory.
+#
+# - Zydis' test suite mainly focuses on edge cases
+# - Radare focuses on real-world instructions
+#
+# Because this script imports test sets from other projects, they are subject to their licenses.
+# This shell script is not subject to any restrictions, coming from the original license (../../LICENSE), that conflict with the other licenses.
+# The other licenses are available in the ../Licenses directory.
+#
+# Every file holds one instruction per line as hex digits, the machine mode is in its name and Example/CMakeLists.txt lists it.
+
+set -eo pipefail
+
+base="${1:-$(dirname "$0")}"
+mkdir -p "$base"
+base="$(cd "$base" && pwd)"
+
+# Every file is written to a temporary directory first and only moved once all of them are complete, so that a failed download never leaves a partial corpus behind
+temp_dir=$(mktemp -d)
+trap 'rm -rf "$temp_dir"' EXIT
+
+## Radare (License at ../Licenses/LICENSE.radare2)
+
+radare_revision=a664277a3536246b3d1ff56675f99fdd354e10b8
+
+for bits in 64 32 16; do
+	{
+		echo "# Imported from radare2 ($radare_revision), licensed under ../Licenses/LICENSE.radare2"
+		curl -sf "https://raw.githubusercontent.com/radareorg/radare2/$radare_revision/test/db/asm/x86_$bits" \
+			| awk -F'#' '{ print $1; }' | awk '{ print $NF; }' | grep -E '^[0-9a-fA-F]+$'
+	} > "$temp_dir/radare2-$bits.txt"
+done
+
+## Zydis (License at ../Licenses/LICENSE.zydis)
+
+zydis_tag=v4.1.1
+
+git clone -q https://github.com/zyantific/zydis.git --depth 1 -b "$zydis_tag" "$temp_dir/zydis"
+
+for bits in 64 32 16; do
+	echo "# Imported from Zydis ($zydis_tag), licensed under ../Licenses/LICENSE.zydis" > "$temp_dir/zydis-$bits.txt"
+done
+for f in "$temp_dir"/zydis/tests/cases/*.in; do
+	read -r arch bytes _ < "$f"
+	echo "$bytes" >> "$temp_dir/zydis-${arch:1:2}.txt"
+done
+
+for bits in 64 32 16; do
+	mv "$temp_dir/radare2-$bits.txt" "$temp_dir/zydis-$bits.txt" "$base/"
+done
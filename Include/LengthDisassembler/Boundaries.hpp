@@ -0,0 +1,54 @@
+#ifndef LENGTHDISASSEMBLER_BOUNDARIES_HPP
+#define LENGTHDISASSEMBLER_BOUNDARIES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <vector>
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+namespace LengthDisassembler {
+	struct BoundaryChanges {
+		// The range that has been decoded again, all boundaries outside of it are unchanged
+		std::size_t begin;
+		std::size_t end;
+
+		std::vector<std::size_t> added; // Offsets that are instruction boundaries now, in ascending order
+		std::vector<std::size_t> removed; // Offsets that are no instruction boundaries anymore, in ascending order
+	};
+
+	// The instruction boundaries of a code region, as found by a linear sweep from its first byte.
+	// After the code has been patched, `update` decodes again from the last boundary before the patch until the instructions
+	// line up with the old boundaries behind it, so its cost depends on the size of the patch rather than the size of the region.
+	class BoundaryMap {
+	public:
+		// NOTE: Fails the same way as `sweep`, the error is the one of the first instruction that couldn't be decoded.
+		static std::expected<BoundaryMap, SweepError> build(std::span<const std::byte> code, MachineMode mode = MachineMode::LONG_MODE);
+
+		// `code` is the whole region with the patch applied, it has to be as large as the region the map was built from.
+		// `[offset, offset + length)` are the bytes that have changed, calling this once for several patches works as well.
+		// NOTE: An error leaves the map as it was, e.g. to try again once the patch is complete.
+		std::expected<BoundaryChanges, SweepError> update(std::span<const std::byte> code, std::size_t offset, std::size_t length);
+
+		bool is_boundary(std::size_t offset) const { return (bits[offset / 64] >> (offset % 64) & 1) != 0; }
+
+		// The start of the instruction that contains `offset`, which has to be inside the region
+		std::size_t instruction_start(std::size_t offset) const;
+
+		std::size_t size() const { return region_size; }
+		std::size_t count() const { return instruction_count; } // The amount of instructions in the region
+		MachineMode mode() const { return machine_mode; }
+
+	private:
+		BoundaryMap(std::size_t size, MachineMode mode);
+
+		std::vector<std::uint64_t> bits; // Bit `offset % 64` of `bits[offset / 64]` is set for every instruction start
+		std::size_t region_size;
+		std::size_t instruction_count = 0;
+		MachineMode machine_mode;
+	};
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef LENGTHDISASSEMBLER_CONSTEXPR_HPP
+#define LENGTHDISASSEMBLER_CONSTEXPR_HPP
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <utility>
+
+#include "LengthDisassembler/Detail/Decoder.hpp"
+
+namespace LengthDisassembler {
+	// These overloads run the same decoder as `disassemble`, but can be evaluated at compile time.
+	// At most MAX_INSTRUCTION_LENGTH bytes of `bytes` are looked at.
+	template <MachineMode Mode>
+	constexpr std::expected<Instruction, Error> disassemble(std::span<const std::byte> bytes)
+	{
+		return Detail::decode<Mode>(bytes.data(), static_cast<std::uint8_t>(std::min<std::size_t>(bytes.size(), MAX_INSTRUCTION_LENGTH)), bytes.size());
+	}
+
+	constexpr std::expected<Instruction, Error> disassemble(std::span<const std::byte> bytes, MachineMode mode = MachineMode::LONG_MODE)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return disassemble<MachineMode::VIRTUAL8086>(bytes);
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return disassemble<MachineMode::LONG_COMPATIBILITY_MODE>(bytes);
+		case MachineMode::LONG_MODE:
+			return disassemble<MachineMode::LONG_MODE>(bytes);
+		default:
+			std::unreachable();
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_BYTESTREAM_HPP
+#define LENGTHDISASSEMBLER_DETAIL_BYTESTREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace LengthDisassembler::Detail {
+	// Without `Checked`, reads and skips aren't bounds-checked, the caller has to make sure that they stay within `readable`.
+	// `has` and `empty` still respect `length`, and `overran` tells whether the stream has moved past it.
+	template <bool Checked>
+	class ByteStream {
+		template <bool>
+		friend class ByteStream;
+
+		const std::byte* bytes;
+		const std::uint8_t length;
+		const std::size_t readable; // The amount of bytes that can be safely read, this may exceed `length`
+
+		std::uint8_t index = 0;
+
+	public:
+		constexpr ByteStream(const std::byte* bytes, std::uint8_t length, std::size_t readable)
+			: bytes(bytes)
+			, length(length)
+			, readable(readable)
+		{
+		}
+
+		constexpr ByteStream(const std::byte* bytes, std::uint8_t length)
+			: ByteStream(bytes, length, length)
+		{
+		}
+
+		constexpr std::optional<std::uint8_t> next()
+		{
+			if constexpr (Checked)
+				if (empty())
+					return std::nullopt;
+			return static_cast<std::uint8_t>(bytes[index++]);
+		};
+
+		[[nodiscard]] constexpr std::optional<std::uint8_t> peek(std::size_t n = 0) const
+		{
+			if constexpr (Checked)
+				if (!has(n + 1))
+					return std::nullopt;
+			return static_cast<std::uint8_t>(bytes[index + n]);
+		};
+
+		[[nodiscard]] constexpr bool has(std::size_t n) const
+		{
+			return index + n <= length;
+		}
+
+		[[nodiscard]] constexpr bool empty() const
+		{
+			return index >= length;
+		}
+
+		[[nodiscard]] constexpr std::uint8_t offset() const
+		{
+			return index;
+		}
+
+		[[nodiscard]] constexpr std::uint8_t remaining() const
+		{
+			return length - index;
+		}
+
+		[[nodiscard]] constexpr bool can_read(std::size_t n) const
+		{
+			return index + n <= readable;
+		}
+
+		[[nodiscard]] constexpr const std::byte* current() const
+		{
+			return bytes + index;
+		}
+
+		constexpr bool consume(std::size_t n)
+		{
+			if constexpr (Checked) {
+				if (index + n > length) {
+					index = length;
+					return false;
+				}
+			}
+			index += static_cast<std::uint8_t>(n);
+			return true;
+		}
+
+		[[nodiscard]] constexpr bool overran() const
+		{
+			if constexpr (Checked)
+				return false; // `consume` stops at `length`
+			else
+				return index > length;
+		}
+
+		// Continues at the same offset without bounds checks
+		[[nodiscard]] constexpr ByteStream<false> unchecked() const
+		{
+			ByteStream<false> stream{ bytes, length, readable };
+			stream.index = index;
+			return stream;
+		}
+	};
+}
+
+#endif
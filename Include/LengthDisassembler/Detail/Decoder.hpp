@@ -0,0 +1,617 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_DECODER_HPP
+#define LENGTHDISASSEMBLER_DETAIL_DECODER_HPP
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <utility>
+
+#include "ByteStream.hpp"
+#include "Fields.hpp"
+#include "Instrumentation.hpp"
+#include "Opcodes.hpp"
+#include "Prefixes.hpp"
+#include "StateMachine.hpp"
+
+// NOTE: If you plan on reading through this entire code, please start at the LengthDisassembler::Detail::decode_handwritten function
+// Everything in here is constexpr, the same code is used for decoding at runtime and at compile time.
+
+// NOLINTBEGIN(cppcoreguidelines-macro-usage, bugprone-macro-parentheses, cppcoreguidelines-avoid-do-while)
+#define PROPAGATE_RESULT_AND_DEFINE(name, result)         \
+	typename decltype((result))::value_type name;         \
+	do {                                                  \
+		if (auto _result = (result); _result.has_value()) \
+			name = _result.value();                       \
+		else                                              \
+			return std::unexpected(_result.error());      \
+	} while (0)
+#define PROPAGATE_RESULT(result)                           \
+	do {                                                   \
+		if (auto _result = (result); !_result.has_value()) \
+			return std::unexpected(_result.error());       \
+	} while (0)
+#define NO_MORE_DATA_IF(result)                          \
+	do {                                                 \
+		if ((result))                                    \
+			return std::unexpected(Error::NO_MORE_DATA); \
+	} while (0)
+// NOLINTEND(cppcoreguidelines-macro-usage, bugprone-macro-parentheses, cppcoreguidelines-avoid-do-while)
+
+namespace LengthDisassembler::Detail {
+	template <MachineMode Mode>
+	constexpr void count_prefixes(ByteStream<true>& bytes,
+		bool& operand_override_prefix,
+		bool& address_override_prefix,
+		bool& operand_size_override)
+	{
+		// REX prefixes only exist in 64-bit mode, elsewhere these bytes are INC/DEC
+		constexpr std::uint8_t ACCEPTED = Mode == MachineMode::LONG_MODE
+			? Prefixes::LEGACY | Prefixes::REX
+			: Prefixes::LEGACY;
+
+		const Prefixes::Run run = Prefixes::scan(bytes.current(), bytes.remaining(), ACCEPTED);
+
+		operand_override_prefix = run.operand_override_prefix;
+		address_override_prefix = run.address_override_prefix;
+		operand_size_override = run.operand_size_override;
+
+		bytes.consume(run.length);
+	}
+
+	// The decoder is instantiated once per machine mode, which pushes some helpers past the inliner's budget.
+	// Calling them out of line forces the Instruction fields they write to into memory, so keep them inline.
+	template <bool Checked>
+	[[gnu::always_inline]] constexpr std::expected<void, Error> parse_opcode(ByteStream<Checked>& bytes, std::uint8_t& opcode, std::uint8_t& opcode_map)
+	{
+		auto first = bytes.next();
+		if (first.has_value() && first != 0x0F) {
+			opcode = first.value();
+			opcode_map = 0;
+			return {};
+		}
+
+		auto second = bytes.next();
+		if (second.has_value() && second != 0x38 && second != 0x3A) {
+			opcode = second.value();
+			opcode_map = 1;
+			return {};
+		}
+
+		auto third = bytes.next();
+		NO_MORE_DATA_IF(!third);
+
+		opcode = third.value();
+		opcode_map = second == 0x38 ? 2 : 3;
+		return {};
+	}
+
+	struct SIB {
+		std::uint8_t scale : 2;
+		std::uint8_t index : 3;
+		std::uint8_t base : 3;
+
+		template <bool Checked>
+		constexpr std::expected<void, Error> parse(ByteStream<Checked>& bytes)
+		{
+			const std::optional<std::uint8_t> optional = bytes.next();
+			NO_MORE_DATA_IF(!optional);
+			const std::uint8_t byte = optional.value();
+
+			*this = {
+				.scale = static_cast<std::uint8_t>((byte >> 6) & 0b11),
+				.index = static_cast<std::uint8_t>((byte >> 3) & 0b111),
+				.base = static_cast<std::uint8_t>((byte >> 0) & 0b111)
+			};
+
+			return {};
+		}
+	};
+
+	struct ModRM {
+		std::uint8_t mod : 2;
+		std::uint8_t reg : 3;
+		std::uint8_t rm : 3;
+
+		template <bool Checked>
+		[[gnu::always_inline]] constexpr std::expected<void, Error> parse(ByteStream<Checked>& bytes,
+			std::uint8_t& displacement,
+			bool addressing_with_16bit)
+		{
+			const std::optional<std::uint8_t> optional = bytes.next();
+			NO_MORE_DATA_IF(!optional);
+			const std::uint8_t byte = optional.value();
+
+			*this = {
+				.mod = static_cast<std::uint8_t>((byte >> 6) & 0b11),
+				.reg = static_cast<std::uint8_t>((byte >> 3) & 0b111),
+				.rm = static_cast<std::uint8_t>((byte >> 0) & 0b111),
+			};
+
+			if (addressing_with_16bit) {
+				switch (mod) {
+				case 0b00:
+					if (rm == 0b110)
+						displacement = 2;
+					break;
+				case 0b01:
+					displacement = 1;
+					break;
+				case 0b10:
+					displacement = 2;
+					break;
+				default:
+					break;
+				}
+
+				return {};
+			}
+
+			SIB sib{};
+
+			if (mod != 0b11 && rm == 0b100) {
+				PROPAGATE_RESULT(sib.parse(bytes));
+			}
+
+			switch (mod) {
+			case 0b00:
+				if (rm == 0b101)
+					displacement = 4;
+
+				if (sib.base == 0b101)
+					displacement = 4;
+				break;
+			case 0b01:
+				displacement = 1;
+				break;
+			case 0b10:
+				displacement = 4;
+				break;
+			default:
+				break;
+			}
+
+			return {};
+		}
+	};
+
+	// Parses the ModRM byte and flags RIP-relative memory operands, `displacement` receives the size of the displacement
+	template <MachineMode Mode, bool Checked>
+	[[gnu::always_inline]] constexpr std::expected<ModRM, Error> parse_modrm(ByteStream<Checked>& bytes, Instruction& instruction, std::uint8_t& displacement)
+	{
+		instruction.modrm_offset = bytes.offset();
+
+		ModRM modrm{};
+		PROPAGATE_RESULT(modrm.parse(bytes, displacement, instruction.address_bits == 16));
+
+		// 64-bit mode replaces [disp32] with [rip + disp32]
+		if constexpr (Mode == MachineMode::LONG_MODE)
+			instruction.is_rip_relative = modrm.mod == 0b00 && modrm.rm == 0b101;
+
+		return modrm;
+	}
+
+	template <bool Checked>
+	[[gnu::always_inline]] constexpr bool consume_displacement(ByteStream<Checked>& bytes, Displacement& displacement, std::uint8_t size)
+	{
+		displacement = { .offset = bytes.offset(), .size = size };
+		return bytes.consume(size);
+	}
+
+	enum class VexType : std::uint8_t {
+		TWO_BYTE,
+		THREE_BYTE,
+		// This thing must be the greatest invention AMD ever brought forward.
+		THREE_BYTE_XOP,
+		EVEX,
+	};
+
+	template <MachineMode Mode, bool Checked>
+	constexpr std::optional<VexType> type_of_vex(const ByteStream<Checked>& bytes)
+	{
+		if (!bytes.has(2)) {
+			// Even the shortest vex (two-byte vex) is 2 bytes long.
+			return std::nullopt;
+		}
+
+		using enum VexType;
+
+		if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE) {
+			// Some opcodes may clash with VEX, for example 0x62 is also the opcode for BOUND
+			// To disambiguate Intel suggests checking the bits of the next byte
+			// The VEX.R (first bit) is useless as only 8 registers are available.
+			// Thus VEX.R is used to check if the byte is a EVEX or a BOUND in this case
+			const std::uint8_t vex1 = bytes.peek(1).value();
+			const std::uint8_t vex_r = (vex1 >> 7) & 0b1;
+			// Just checking VEX.R does not work, X also needs to be checked, not sure if this is enough.
+			const std::uint8_t vex_x = (vex1 >> 6) & 0b1;
+
+			if (vex_r == 0 || vex_x == 0)
+				// TODO is this correct?
+				return std::nullopt;
+		}
+
+		const std::uint8_t vex_byte = bytes.peek().value();
+		switch (vex_byte) {
+		case 0xC4:
+			if (bytes.has(3))
+				return THREE_BYTE;
+
+			break;
+		case 0xC5:
+			// The top of the function already verifies at least 2 bytes
+			return TWO_BYTE;
+		case 0x8F: {
+			const std::uint8_t opcode_map = bytes.peek(1).value() & 0b11111;
+			if (opcode_map >= 8) // Prevent it from overlapping with other instructions...
+				return THREE_BYTE_XOP;
+
+			break;
+		}
+		case 0x62:
+			if (bytes.has(4))
+				return EVEX;
+
+			break;
+		default:;
+		};
+		return std::nullopt;
+	}
+
+	template <bool Checked>
+	constexpr std::uint8_t parse_two_byte_vex(ByteStream<Checked>& bytes, std::uint8_t& opcode_map)
+	{
+		assert(bytes.has(2));
+
+		[[maybe_unused]] const std::uint8_t b = bytes.next().value();
+		assert(b == 0xC5);
+
+		opcode_map = 0b00001;
+
+		(void)bytes.next();
+		return 2;
+	}
+
+	template <bool Checked>
+	constexpr std::uint8_t parse_three_byte_vex(ByteStream<Checked>& bytes,
+		std::uint8_t& opcode_map,
+		bool& operand_size_override)
+	{
+		assert(bytes.has(3));
+
+		[[maybe_unused]] const std::uint8_t b = bytes.next().value();
+		assert(b == 0xC4);
+
+		opcode_map = bytes.next().value() & 0b11111;
+
+		operand_size_override = (bytes.next().value() >> 7) & 0b1; // VEX.W
+
+		return 3;
+	}
+
+	template <bool Checked>
+	constexpr std::uint8_t parse_three_byte_xop(ByteStream<Checked>& bytes,
+		std::uint8_t& opcode_map,
+		bool& operand_size_override)
+	{
+		assert(bytes.has(3));
+
+		[[maybe_unused]] const std::uint8_t b = bytes.next().value();
+		assert(b == 0x8F);
+
+		opcode_map = bytes.next().value() & 0b11111;
+
+		// The AMD64 Architecture Programmer’s Manual Volume 6 states that the map_select field must be equal to or greater than 8, to differentiate the XOP prefix from the POP instruction that formerly used opcode 0x8F.
+		assert(opcode_map >= 8);
+
+		operand_size_override = (bytes.next().value() >> 7) & 0b1; // VEX.W
+
+		return 3;
+	}
+
+	template <bool Checked>
+	[[gnu::always_inline]] constexpr std::uint8_t parse_evex(ByteStream<Checked>& bytes,
+		std::uint8_t& opcode_map,
+		bool& operand_size_override)
+	{
+		assert(bytes.has(4));
+
+		[[maybe_unused]] const std::uint8_t b = bytes.next().value();
+		assert(b == 0x62);
+
+		opcode_map = bytes.next().value() & 0b111;
+
+		operand_size_override = (bytes.next().value() >> 7) & 0b1; // VEX.W
+
+		(void)bytes.next();
+
+		return 4;
+	}
+
+	template <bool Checked>
+	constexpr bool is_3dnow(const ByteStream<Checked>& bytes)
+	{
+		return bytes.has(2) && bytes.peek() == 0x0F && bytes.peek(1) == 0x0F;
+	}
+
+	template <MachineMode Mode, bool Checked>
+	[[gnu::always_inline]] constexpr std::expected<void, Error> handle_3dnow(ByteStream<Checked>& bytes, Instruction& instruction, Displacement& disp)
+	{
+		[[maybe_unused]] const bool had_0f_0f = bytes.consume(2); // 0x0F0F
+		assert(had_0f_0f);
+
+		std::uint8_t displacement = 0;
+		PROPAGATE_RESULT(parse_modrm<Mode>(bytes, instruction, displacement));
+		NO_MORE_DATA_IF(!consume_displacement(bytes, disp, displacement));
+
+		constexpr std::uint8_t OPCODE_MAP_3D_NOW = 4; // All 3DNOW instructions reside in map 4
+		instruction.opcode_map = OPCODE_MAP_3D_NOW;
+
+		if (auto opcode_byte = bytes.next(); opcode_byte.has_value()) {
+			instruction.opcode = opcode_byte.value();
+
+			return {};
+		}
+
+		return std::unexpected(Error::NO_MORE_DATA);
+	}
+
+	// Decodes the opcodes in Opcodes::SPECIAL_CASES, which a single OpcodeInfo can't describe
+	template <MachineMode Mode, bool Checked>
+	[[gnu::always_inline]] constexpr std::expected<void, Error> decode_special_case(ByteStream<Checked>& stream, Instruction& instruction, Displacement& disp, const Opcodes::SpecialCaseInfo& special_case)
+	{
+		if (!instruction.is_vex || special_case.rel_mode)
+			instruction.control_flow = control_flow_of(instruction.opcode_map, instruction.opcode);
+		instruction.is_relative_branch = special_case.rel_mode;
+
+		std::uint8_t displacement = 0;
+		std::uint8_t reg = 0;
+		if (special_case.modrm_only) {
+			instruction.modrm_offset = stream.offset();
+			NO_MORE_DATA_IF(!stream.next());
+		} else if (special_case.modrm) {
+			PROPAGATE_RESULT_AND_DEFINE(modrm, parse_modrm<Mode>(stream, instruction, displacement));
+			reg = modrm.reg;
+		}
+
+		// This instruction purposely ignores prefixes...
+		if (special_case.disp_mode) {
+			if constexpr (Mode == MachineMode::VIRTUAL8086)
+				displacement = 2;
+			else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+				displacement = 4;
+			else
+				displacement = 8;
+		}
+
+		NO_MORE_DATA_IF(!consume_displacement(stream, disp, displacement));
+
+		std::uint8_t immediates = special_case.legacy_fixed && instruction.is_vex ? 0 : special_case.fixed;
+
+		// Only TEST has an immediate
+		if (special_case.group_3 != Opcodes::GROUP_3_NONE && (reg == 0b0000 || reg == 0b0001))
+			immediates += special_case.group_3 == Opcodes::GROUP_3_BYTE ? 1 : std::min(instruction.operand_bits / 8, 4);
+
+		if (special_case.rel_mode) {
+			if constexpr (Mode == MachineMode::VIRTUAL8086)
+				immediates += 2;
+			else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+				immediates += instruction.operand_bits / 8;
+			else
+				immediates += 4;
+		}
+
+		NO_MORE_DATA_IF(!stream.consume(immediates));
+		return {};
+	}
+
+	// Decodes everything after the prefixes. Without `Checked`, running past `max_length` is only detected at the end,
+	// which results in the same errors as stopping at the first byte that is out of bounds.
+	template <MachineMode Mode, bool Checked>
+	[[gnu::always_inline]] constexpr std::expected<Instruction, Error> decode_after_prefixes(ByteStream<Checked>& stream, Instruction& instruction, const std::byte* bytes)
+	{
+		if (const std::optional<VexType> type = type_of_vex<Mode>(stream); type.has_value()) {
+			instruction.is_vex = true;
+			switch (type.value()) {
+				using enum VexType;
+			case TWO_BYTE:
+				Instrumentation::count(Instrumentation::Counter::VEX);
+				parse_two_byte_vex(stream, instruction.opcode_map);
+				break;
+			case THREE_BYTE:
+				Instrumentation::count(Instrumentation::Counter::VEX);
+				parse_three_byte_vex(stream, instruction.opcode_map, instruction.operand_size_override);
+				break;
+			case THREE_BYTE_XOP:
+				Instrumentation::count(Instrumentation::Counter::XOP);
+				// The XOP prefix is detected by its second byte, the third one may still be missing.
+				NO_MORE_DATA_IF(!stream.has(3));
+				parse_three_byte_xop(stream, instruction.opcode_map, instruction.operand_size_override);
+				break;
+			case EVEX:
+				Instrumentation::count(Instrumentation::Counter::EVEX);
+				parse_evex(stream, instruction.opcode_map, instruction.operand_size_override);
+				break;
+			default:
+				std::unreachable();
+			}
+			if (std::optional<std::uint8_t> optional = stream.next(); optional.has_value()) {
+				instruction.opcode = optional.value();
+			} else {
+				return std::unexpected(Error::NO_MORE_DATA);
+			}
+		}
+
+		instruction.address_bits = get_address_size<Mode>(instruction.address_override_prefix);
+		instruction.operand_bits = get_operand_size<Mode>(instruction.operand_size_override,
+			instruction.operand_override_prefix);
+
+		if (!instruction.is_vex) {
+			if (is_3dnow(stream)) {
+				instruction.is_3dnow = true;
+				Instrumentation::count(Instrumentation::Counter::THREE_DNOW);
+				Displacement disp{};
+				PROPAGATE_RESULT(handle_3dnow<Mode>(stream, instruction, disp));
+				NO_MORE_DATA_IF(stream.overran());
+				finish(instruction, stream.offset(), disp, false); // The trailing byte is the opcode
+				return instruction;
+			}
+
+			PROPAGATE_RESULT(parse_opcode(stream, instruction.opcode, instruction.opcode_map));
+		}
+
+		// Instructions without a displacement have their immediates right after the opcode
+		Displacement disp{ .offset = stream.offset(), .size = 0 };
+
+		const Opcodes::OpcodeInfo* info = Opcodes::lookup(instruction.opcode_map, instruction.opcode);
+
+		if (!info) {
+			// Without bounds checks, the opcode may lie past the end
+			NO_MORE_DATA_IF(stream.overran());
+			return std::unexpected(Error::UNKNOWN_INSTRUCTION);
+		}
+
+		if (Opcodes::is_special_case(*info)) {
+			Instrumentation::count(Instrumentation::Counter::SPECIAL_CASES);
+			PROPAGATE_RESULT(decode_special_case<Mode>(stream, instruction, disp, Opcodes::special_case_of(*info)));
+			NO_MORE_DATA_IF(stream.overran());
+			finish(instruction, stream.offset(), disp, true);
+			if (instruction.is_relative_branch)
+				instruction.branch_displacement = read_branch_displacement(bytes, instruction);
+			return instruction;
+		}
+
+		if (!instruction.is_vex)
+			instruction.control_flow = control_flow_of(instruction.opcode_map, instruction.opcode);
+
+		std::uint8_t displacement = 0;
+		if (info->modrm) {
+			PROPAGATE_RESULT_AND_DEFINE(modrm, parse_modrm<Mode>(stream, instruction, displacement));
+
+			if (instruction.opcode_map == 0 && !instruction.is_vex) {
+				if (instruction.opcode == 0xFF)
+					instruction.control_flow = control_flow_of_group_5(modrm.reg);
+
+				// XBEGIN shares its opcode with MOV r/m, imm
+				if (instruction.opcode == 0xC7 && modrm.mod == 0b11 && modrm.reg == 0b111)
+					instruction.control_flow = ControlFlow::CONDITIONAL_JUMP;
+			}
+		}
+
+		instruction.is_relative_branch = is_relative_branch(instruction.control_flow);
+
+		// Absolute memory offset (moffs), there is no ModRM in this case
+		if (info->disp_asz)
+			displacement = instruction.address_bits / 8;
+
+		NO_MORE_DATA_IF(!consume_displacement(stream, disp, displacement));
+
+		// Relative branch displacements count as immediates
+		if (info->disp_osz) {
+			const std::uint8_t bytes = std::min(instruction.operand_bits / 8, 4);
+			NO_MORE_DATA_IF(!stream.consume(bytes));
+		}
+
+		NO_MORE_DATA_IF(!stream.consume(info->fixed));
+
+		if (info->imm_osz) {
+			const std::uint8_t bytes = std::min(instruction.operand_bits / 8, 4);
+			NO_MORE_DATA_IF(!stream.consume(bytes));
+		}
+
+		if (info->uimm_osz) {
+			const std::uint8_t bytes = instruction.operand_bits / 8;
+			NO_MORE_DATA_IF(!stream.consume(bytes));
+		}
+
+		NO_MORE_DATA_IF(stream.overran());
+		finish(instruction, stream.offset(), disp, true);
+		if (instruction.is_relative_branch)
+			instruction.branch_displacement = read_branch_displacement(bytes, instruction);
+		return instruction;
+	}
+
+	// `readable` is the amount of bytes that can be safely read starting at `bytes`, it may exceed `max_length`, which lets the decoder skip its bounds checks.
+	template <MachineMode Mode>
+	[[gnu::always_inline]] constexpr std::expected<Instruction, Error> decode_handwritten(const std::byte* bytes, std::uint8_t max_length, std::size_t readable)
+	{
+		static_assert(Mode == MachineMode::VIRTUAL8086 || Mode == MachineMode::LONG_COMPATIBILITY_MODE || Mode == MachineMode::LONG_MODE);
+
+		ByteStream<true> stream{ bytes, max_length, readable };
+
+		Instruction instruction{
+			.length = 0,
+
+			.opcode_map = 0,
+			.opcode = 0,
+
+			.address_bits = 0,
+			.operand_bits = 0,
+
+			.operand_override_prefix = false,
+			.address_override_prefix = false,
+
+			.operand_size_override = false,
+
+			.is_vex = false,
+			.is_3dnow = false,
+
+			.is_rip_relative = false,
+			.is_relative_branch = false,
+
+			.control_flow = ControlFlow::NONE,
+
+			.modrm_offset = 0,
+			.disp_offset = 0,
+			.disp_size = 0,
+			.imm_offset = 0,
+			.imm_size = 0,
+
+			.branch_displacement = 0,
+		};
+
+		count_prefixes<Mode>(stream,
+			instruction.operand_override_prefix,
+			instruction.address_override_prefix,
+			instruction.operand_size_override);
+
+		NO_MORE_DATA_IF(stream.empty());
+
+		// Past the prefixes, no instruction reads more than MAX_INSTRUCTION_LENGTH bytes, not even an invalid one,
+		// so the bounds checks are only needed when the readable bytes end within that range, e.g. at the end of a sweep.
+		if (stream.can_read(MAX_INSTRUCTION_LENGTH)) [[likely]] {
+			Instrumentation::count(Instrumentation::Counter::UNCHECKED);
+			ByteStream<false> unchecked = stream.unchecked();
+			return decode_after_prefixes<Mode>(unchecked, instruction, bytes);
+		}
+		return decode_after_prefixes<Mode>(stream, instruction, bytes);
+	}
+
+	// Both decoders return the same for every input, LENGTHDISASSEMBLER_STATE_MACHINE_DECODER selects the table-driven one
+	template <MachineMode Mode>
+	[[gnu::always_inline]] constexpr std::expected<Instruction, Error> decode(const std::byte* bytes, std::uint8_t max_length, std::size_t readable)
+	{
+#ifdef LENGTHDISASSEMBLER_STATE_MACHINE_DECODER
+		std::expected<Instruction, Error> result = StateMachine::decode<Mode>(bytes, max_length, readable);
+#else
+		std::expected<Instruction, Error> result = decode_handwritten<Mode>(bytes, max_length, readable);
+#endif
+
+		Instrumentation::count(Instrumentation::Counter::INSTRUCTIONS);
+		if (!result.has_value())
+			Instrumentation::count(result.error() == Error::NO_MORE_DATA ? Instrumentation::Counter::NO_MORE_DATA : Instrumentation::Counter::UNKNOWN_INSTRUCTION);
+
+		return result;
+	}
+}
+
+#undef NO_MORE_DATA_IF
+#undef PROPAGATE_RESULT
+#undef PROPAGATE_RESULT_AND_DEFINE
+
+#endif
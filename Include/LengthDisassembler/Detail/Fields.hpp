@@ -0,0 +1,146 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_FIELDS_HPP
+#define LENGTHDISASSEMBLER_DETAIL_FIELDS_HPP
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The parts of an Instruction that don't depend on how its bytes have been walked, shared by both decoders
+
+namespace LengthDisassembler::Detail {
+	// Where the memory displacement is, the immediates start right after it
+	struct Displacement {
+		std::uint8_t offset;
+		std::uint8_t size;
+	};
+
+	// Everything between the displacement and the end of the instruction is immediates
+	[[gnu::always_inline]] constexpr void finish(Instruction& instruction, std::uint8_t length, Displacement displacement, bool has_immediates)
+	{
+		const std::uint8_t imm_offset = displacement.offset + displacement.size;
+		const std::uint8_t imm_size = has_immediates ? length - imm_offset : 0;
+
+		instruction.length = length;
+		instruction.disp_offset = displacement.size != 0 ? displacement.offset : 0;
+		instruction.disp_size = displacement.size;
+		instruction.imm_offset = imm_size != 0 ? imm_offset : 0;
+		instruction.imm_size = imm_size;
+	}
+
+	// Indexed by `opcode_map * 256 + opcode`, only the legacy maps 0 and 1 contain control flow instructions.
+	// FF and C7 depend on ModRM.reg, so they are classified after it has been parsed.
+	constexpr std::array<ControlFlow, 512> CONTROL_FLOWS = [] {
+		std::array<ControlFlow, 512> control_flows{};
+
+		for (std::size_t opcode = 0x70; opcode <= 0x7F; opcode++)
+			control_flows[opcode] = ControlFlow::CONDITIONAL_JUMP; // Jcc rel8
+		for (std::size_t opcode = 0xE0; opcode <= 0xE3; opcode++)
+			control_flows[opcode] = ControlFlow::CONDITIONAL_JUMP; // LOOPcc and JrCXZ
+		control_flows[0xE8] = ControlFlow::CALL;
+		control_flows[0xE9] = ControlFlow::JUMP;
+		control_flows[0xEB] = ControlFlow::JUMP;
+		control_flows[0x9A] = ControlFlow::INDIRECT_CALL; // CALL ptr16:16/32
+		control_flows[0xEA] = ControlFlow::INDIRECT_JUMP; // JMP ptr16:16/32
+		for (const std::size_t opcode : { 0xC2, 0xC3, 0xCA, 0xCB, 0xCF })
+			control_flows[opcode] = ControlFlow::RETURN;
+		for (const std::size_t opcode : { 0xCC, 0xF1, 0xF4 })
+			control_flows[opcode] = ControlFlow::TRAP;
+
+		for (std::size_t opcode = 0x80; opcode <= 0x8F; opcode++)
+			control_flows[0x100 + opcode] = ControlFlow::CONDITIONAL_JUMP; // Jcc rel16/32
+		control_flows[0x107] = ControlFlow::RETURN; // SYSRET
+		control_flows[0x135] = ControlFlow::RETURN; // SYSEXIT
+		for (const std::size_t opcode : { 0x0B, 0xB9, 0xFF })
+			control_flows[0x100 + opcode] = ControlFlow::TRAP; // UD2, UD1, UD0
+
+		return control_flows;
+	}();
+
+	constexpr ControlFlow control_flow_of(std::uint8_t opcode_map, std::uint8_t opcode)
+	{
+		if (opcode_map > 1)
+			return ControlFlow::NONE;
+		return CONTROL_FLOWS[opcode_map * 256 + opcode];
+	}
+
+	// FF /2 to FF /5
+	constexpr ControlFlow control_flow_of_group_5(std::uint8_t reg)
+	{
+		switch (reg) {
+		case 0b010:
+		case 0b011:
+			return ControlFlow::INDIRECT_CALL;
+		case 0b100:
+		case 0b101:
+			return ControlFlow::INDIRECT_JUMP;
+		default:
+			return ControlFlow::NONE;
+		}
+	}
+
+	// Branches whose immediate is a displacement to the target
+	constexpr bool is_relative_branch(ControlFlow control_flow)
+	{
+		return control_flow == ControlFlow::CALL || control_flow == ControlFlow::JUMP || control_flow == ControlFlow::CONDITIONAL_JUMP;
+	}
+
+	// Sign extends the immediate of a relative branch
+	constexpr std::int32_t read_branch_displacement(const std::byte* bytes, const Instruction& instruction)
+	{
+		std::uint32_t value = 0;
+		for (std::uint8_t i = 0; i < instruction.imm_size; i++)
+			value |= static_cast<std::uint32_t>(bytes[instruction.imm_offset + i]) << (8 * i);
+
+		const unsigned unused_bits = 32 - 8 * instruction.imm_size;
+		return static_cast<std::int32_t>(value << unused_bits) >> unused_bits;
+	}
+
+	/*
+	 * Address and Operands size overrides in Long 64-bit mode:
+	 *      REX.W   Prefix  Operand     Address
+	 *      0       No      32-bit      64-bit
+	 *      0       Yes     16-bit      32-bit
+	 *      1       No      64-bit[1]   64-bit
+	 *      1       Yes     64-bit      32-bit
+	 *
+	 * [1] Some instructions don't need REX.W for 64-bit operands
+	 *
+	 *
+	 * Long compatibility mode:
+	 *
+	 *      Prefix  Operand     Address
+	 *      No      32-bit      32-bit
+	 *      Yes     16-bit      16-bit
+	 */
+
+	// TODO, when VEX implies 0x66 prefix, does that count?
+
+	template <MachineMode Mode>
+	constexpr std::uint8_t get_address_size(bool prefix)
+	{
+		if constexpr (Mode == MachineMode::VIRTUAL8086)
+			return prefix ? 32 : 16;
+		else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+			return prefix ? 16 : 32;
+		else
+			return prefix ? 32 : 64;
+	}
+
+	template <MachineMode Mode>
+	constexpr std::uint8_t get_operand_size(bool rex_w, bool prefix)
+	{
+		if constexpr (Mode == MachineMode::VIRTUAL8086)
+			return prefix ? 32 : 16;
+		else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+			return prefix ? 16 : 32;
+		else {
+			if (!rex_w)
+				return prefix ? 16 : 32;
+			return 64;
+		}
+	}
+}
+
+#endif
@@ -1,113 +1,128 @@
 // This file has been generated, do not edit manually.
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_0[] = {
+constexpr SPECIAL_CASE SPECIAL_CASES[] = {
+	SPECIAL_CASE_DEF(0, 246, 246, SPECIAL_CASE_INFO_DEF(true, false, 1, false, false, 0, false)), // Group 3, TEST has a 1-byte immediate
+	SPECIAL_CASE_DEF(0, 247, 247, SPECIAL_CASE_INFO_DEF(true, false, 2, false, false, 0, false)), // Group 3, TEST has an immediate of the operand size
+	SPECIAL_CASE_DEF(0, 161, 161, SPECIAL_CASE_INFO_DEF(false, false, 0, true, false, 0, false)), // MOV EAX, moffs purposely ignores prefixes
+	SPECIAL_CASE_DEF(0, 232, 233, SPECIAL_CASE_INFO_DEF(false, false, 0, false, true, 0, false)), // CALL/JMP rel16/32
+	SPECIAL_CASE_DEF(1, 120, 120, SPECIAL_CASE_INFO_DEF(true, false, 0, false, false, 2, true)), // VMREAD or EXTRQ or INSERTQ, the latter two have two 1-byte immediates
+	SPECIAL_CASE_DEF(1, 32, 33, SPECIAL_CASE_INFO_DEF(true, true, 0, false, false, 0, false)), // MOV CR/DR, take modrm, but just don't care about its displacement
+};
+
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_0[] = {
+	RANGE_OPCODE_INSN_DEF(232, 233, OPCODE_INSN_DEF(false, 3, true, true, false, false)), // SPECIAL_CASES[3]
+	RANGE_OPCODE_INSN_DEF(132, 143, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(184, 191, OPCODE_INSN_DEF(false, 0, false, false, false, true)),
+	RANGE_OPCODE_INSN_DEF(130, 131, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(56, 59, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(129, 129, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(199, 199, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(192, 193, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(48, 51, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(198, 198, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(105, 105, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(0, 3, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(40, 43, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(32, 35, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(8, 11, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(246, 246, OPCODE_INSN_DEF(false, 0, true, true, false, false)), // SPECIAL_CASES[0]
+	RANGE_OPCODE_INSN_DEF(247, 247, OPCODE_INSN_DEF(false, 1, true, true, false, false)), // SPECIAL_CASES[1]
+	RANGE_OPCODE_INSN_DEF(236, 253, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(176, 183, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(254, 255, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(98, 99, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(208, 211, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(5, 5, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(24, 27, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(16, 19, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(53, 53, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(60, 60, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(106, 106, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(4, 4, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(63, 97, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(61, 104, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(37, 37, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(168, 168, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(112, 127, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(236, 253, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(132, 143, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(169, 169, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(12, 12, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(13, 13, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
+	RANGE_OPCODE_INSN_DEF(36, 36, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(144, 153, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(176, 183, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(184, 191, OPCODE_INSN_DEF(false, 0, false, false, false, true)),
+	RANGE_OPCODE_INSN_DEF(52, 52, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(28, 28, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(203, 204, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(195, 195, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(235, 235, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(216, 223, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(224, 231, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(170, 175, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(155, 159, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(0, 3, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(8, 11, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(16, 19, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(24, 27, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(32, 35, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(40, 43, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(48, 51, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(56, 59, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(108, 111, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(107, 128, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(164, 167, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(208, 211, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(161, 161, OPCODE_INSN_DEF(false, 2, true, true, false, false)), // SPECIAL_CASES[2]
 	RANGE_OPCODE_INSN_DEF(160, 163, OPCODE_INSN_DEF(false, 0, true, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(6, 7, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(22, 23, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(30, 31, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(98, 99, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(61, 104, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
-	RANGE_OPCODE_INSN_DEF(107, 128, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(130, 131, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(192, 193, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(196, 197, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(203, 204, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(206, 207, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(205, 213, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(214, 215, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(254, 255, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(4, 4, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(5, 5, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
-	RANGE_OPCODE_INSN_DEF(12, 12, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(13, 13, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(14, 14, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(20, 20, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(21, 21, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
-	RANGE_OPCODE_INSN_DEF(28, 28, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(29, 29, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
-	RANGE_OPCODE_INSN_DEF(36, 36, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(37, 37, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(39, 39, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(44, 44, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(45, 45, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(47, 47, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(52, 52, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(53, 53, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(55, 55, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(60, 60, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(105, 105, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
-	RANGE_OPCODE_INSN_DEF(106, 106, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(129, 129, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(154, 154, OPCODE_INSN_DEF(false, 2, false, true, false, false)),
-	RANGE_OPCODE_INSN_DEF(168, 168, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(169, 169, OPCODE_INSN_DEF(false, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(194, 194, OPCODE_INSN_DEF(false, 2, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(195, 195, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(198, 198, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(199, 199, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
 	RANGE_OPCODE_INSN_DEF(200, 200, OPCODE_INSN_DEF(false, 3, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(201, 201, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(202, 202, OPCODE_INSN_DEF(false, 2, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(234, 234, OPCODE_INSN_DEF(false, 2, false, true, false, false)),
-	RANGE_OPCODE_INSN_DEF(235, 235, OPCODE_INSN_DEF(false, 1, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_1[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_1[] = {
 	RANGE_OPCODE_INSN_DEF(64, 111, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(208, 255, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(173, 185, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(32, 33, OPCODE_INSN_DEF(false, 5, true, true, false, false)), // SPECIAL_CASES[5]
 	RANGE_OPCODE_INSN_DEF(16, 47, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(187, 193, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(208, 255, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(112, 115, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(196, 198, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(165, 167, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(164, 164, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(172, 194, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(128, 143, OPCODE_INSN_DEF(false, 0, false, true, false, false)),
+	RANGE_OPCODE_INSN_DEF(120, 120, OPCODE_INSN_DEF(false, 4, true, true, false, false)), // SPECIAL_CASES[4]
 	RANGE_OPCODE_INSN_DEF(120, 159, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(173, 185, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(14, 55, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(200, 207, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(187, 193, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(171, 199, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(5, 11, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(0, 13, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(112, 115, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(119, 162, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(116, 163, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(165, 167, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(14, 55, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
+	RANGE_OPCODE_INSN_DEF(0, 13, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(168, 170, OPCODE_INSN_DEF(false, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(172, 194, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(196, 198, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(171, 199, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
-	RANGE_OPCODE_INSN_DEF(164, 164, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_2[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_2[] = {
 	RANGE_OPCODE_INSN_DEF(0, 252, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_3[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_3[] = {
 	RANGE_OPCODE_INSN_DEF(0, 70, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(74, 240, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(72, 73, OPCODE_INSN_DEF(true, 2, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_4[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_4[] = {
 	RANGE_OPCODE_INSN_DEF(48, 102, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(132, 191, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 	RANGE_OPCODE_INSN_DEF(0, 35, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
@@ -120,33 +135,33 @@ const OPCODE_INFO_RANGE OPCODE_TABLE_4[] = {
 	RANGE_OPCODE_INSN_DEF(105, 247, OPCODE_INSN_DEF(true, 0, false, false, true, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_5[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_5[] = {
 	RANGE_OPCODE_INSN_DEF(16, 253, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_6[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_6[] = {
 	RANGE_OPCODE_INSN_DEF(19, 215, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_7[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_7[] = {
 	RANGE_OPCODE_INSN_DEF(246, 248, OPCODE_INSN_DEF(true, 4, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_8[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_8[] = {
 	RANGE_OPCODE_INSN_DEF(133, 239, OPCODE_INSN_DEF(true, 1, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_9[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_9[] = {
 	RANGE_OPCODE_INSN_DEF(1, 227, OPCODE_INSN_DEF(true, 0, false, false, false, false)),
 };
 
-const OPCODE_INFO_RANGE OPCODE_TABLE_10[] = {
+constexpr OPCODE_INFO_RANGE OPCODE_TABLE_10[] = {
 	RANGE_OPCODE_INSN_DEF(16, 18, OPCODE_INSN_DEF(true, 4, false, false, false, false)),
 };
 
-const OPCODE_TABLE_DEFINITION OPCODE_TABLES[] = {
-	OPCODE_TABLE_DEF(OPCODE_TABLE_0, 71),
-	OPCODE_TABLE_DEF(OPCODE_TABLE_1, 20),
+constexpr OPCODE_TABLE_DEFINITION OPCODE_TABLES[] = {
+	OPCODE_TABLE_DEF(OPCODE_TABLE_0, 75),
+	OPCODE_TABLE_DEF(OPCODE_TABLE_1, 22),
 	OPCODE_TABLE_DEF(OPCODE_TABLE_2, 1),
 	OPCODE_TABLE_DEF(OPCODE_TABLE_3, 3),
 	OPCODE_TABLE_DEF(OPCODE_TABLE_4, 10),
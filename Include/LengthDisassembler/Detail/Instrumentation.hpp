@@ -0,0 +1,118 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_INSTRUMENTATION_HPP
+#define LENGTHDISASSEMBLER_DETAIL_INSTRUMENTATION_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#ifdef LENGTHDISASSEMBLER_INSTRUMENTATION
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace LengthDisassembler::Detail::Instrumentation {
+	// See LengthDisassembler::Counters for what they count
+	enum class Counter : std::uint8_t {
+		INSTRUCTIONS,
+		UNCHECKED,
+		NO_MORE_DATA,
+		UNKNOWN_INSTRUCTION,
+		VEX,
+		EVEX,
+		XOP,
+		THREE_DNOW,
+		SPECIAL_CASES,
+		RANGE_LOOKUPS,
+		RANGE_ENTRIES_SCANNED,
+	};
+
+	constexpr std::size_t COUNTER_COUNT = std::to_underlying(Counter::RANGE_ENTRIES_SCANNED) + 1;
+
+	using Totals = std::array<std::uint64_t, COUNTER_COUNT>;
+
+#ifdef LENGTHDISASSEMBLER_INSTRUMENTATION
+	struct ThreadCounters;
+
+	// Every thread registers its counters on its first decode, the counters of threads that have exited are kept in `retired`.
+	struct Registry {
+		std::mutex mutex;
+		std::vector<const ThreadCounters*> threads;
+		Totals retired{};
+		Totals baseline{}; // The totals at the last reset, which snapshots subtract
+	};
+
+	inline Registry REGISTRY;
+
+	// Only the owning thread writes its counters, so they are incremented with a plain load and store instead of a locked
+	// read-modify-write. They are atomic so that snapshots can read them from other threads.
+	struct ThreadCounters {
+		std::array<std::atomic<std::uint64_t>, COUNTER_COUNT> values{};
+
+		ThreadCounters()
+		{
+			const std::lock_guard lock{ REGISTRY.mutex };
+			REGISTRY.threads.push_back(this);
+		}
+
+		ThreadCounters(const ThreadCounters&) = delete;
+		ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+		~ThreadCounters()
+		{
+			const std::lock_guard lock{ REGISTRY.mutex };
+			for (std::size_t i = 0; i < COUNTER_COUNT; i++)
+				REGISTRY.retired[i] += values[i].load(std::memory_order_relaxed);
+			std::erase(REGISTRY.threads, this);
+		}
+	};
+
+	inline thread_local ThreadCounters THREAD_COUNTERS;
+
+	// The sum over all threads, without the baseline. The registry has to be locked.
+	inline Totals sum_locked()
+	{
+		Totals totals = REGISTRY.retired;
+		for (const ThreadCounters* thread : REGISTRY.threads)
+			for (std::size_t i = 0; i < COUNTER_COUNT; i++)
+				totals[i] += thread->values[i].load(std::memory_order_relaxed);
+		return totals;
+	}
+#endif
+
+	// Compiles to nothing without LENGTHDISASSEMBLER_INSTRUMENTATION, and never counts during constant evaluation
+	[[gnu::always_inline]] constexpr void count([[maybe_unused]] Counter counter, [[maybe_unused]] std::uint64_t amount = 1)
+	{
+#ifdef LENGTHDISASSEMBLER_INSTRUMENTATION
+		if !consteval {
+			std::atomic<std::uint64_t>& value = THREAD_COUNTERS.values[std::to_underlying(counter)];
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+#endif
+	}
+
+	inline Totals snapshot()
+	{
+		Totals totals{};
+#ifdef LENGTHDISASSEMBLER_INSTRUMENTATION
+		const std::lock_guard lock{ REGISTRY.mutex };
+		totals = sum_locked();
+		for (std::size_t i = 0; i < COUNTER_COUNT; i++)
+			totals[i] -= REGISTRY.baseline[i];
+#endif
+		return totals;
+	}
+
+	// Moves the baseline instead of clearing the counters, which would race with the threads that own them
+	inline void reset()
+	{
+#ifdef LENGTHDISASSEMBLER_INSTRUMENTATION
+		const std::lock_guard lock{ REGISTRY.mutex };
+		REGISTRY.baseline = sum_locked();
+#endif
+	}
+}
+
+#endif
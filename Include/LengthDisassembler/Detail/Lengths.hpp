@@ -0,0 +1,189 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_LENGTHS_HPP
+#define LENGTHDISASSEMBLER_DETAIL_LENGTHS_HPP
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+
+#include "Decoder.hpp"
+#include "Fields.hpp"
+#include "Prefixes.hpp"
+#include "StateMachine.hpp"
+
+// A shortcut for sweeps that only need the lengths. Most instructions of compiled code have at most one legacy prefix and a REX prefix,
+// and their length only depends on the opcode, the operand size and the ModRM and SIB bytes, which direct-indexed tables tell in a few loads.
+// Everything else, e.g. VEX, more prefixes, group 3 or invalid opcodes, is left to the decoder.
+// The tables are derived at compile time from the descriptors of the state machine, so the shortcut agrees with both decoders.
+
+namespace LengthDisassembler::Detail::Lengths {
+	// The operand size that the prefixes select
+	constexpr std::size_t DEFAULT_OPERANDS = 0;
+	constexpr std::size_t OVERRIDDEN_OPERANDS = 1; // 66
+	constexpr std::size_t WIDE_OPERANDS = 2; // REX.W, which wins over 66
+	constexpr std::size_t OPERAND_SIZES = 3;
+
+	// An entry of an opcode table is either an opcode that the shortcut knows, or what else the byte is to it
+	constexpr std::uint8_t KNOWN = 1 << 7;
+	constexpr std::uint8_t HAS_MODRM = 1 << 6;
+	constexpr std::uint8_t TAIL = 0b11111; // The bytes after the opcode, without the ModRM byte and what it implies
+
+	constexpr std::uint8_t DECODE = 0; // Anything the shortcut doesn't know is up to the decoder
+	constexpr std::uint8_t ESCAPE = 1; // 0F, the opcode follows in map 1
+	constexpr std::uint8_t LEGACY_PREFIX = 2; // 66, F2 or F3, only as the first byte
+	constexpr std::uint8_t REX_PREFIX = 3; // 40 to 4F in 64-bit mode, only right before the opcode
+
+	template <MachineMode Mode>
+	consteval std::uint8_t describe(std::size_t operand_size, std::uint8_t opcode_map, std::uint8_t opcode)
+	{
+		const StateMachine::Transition transition = StateMachine::TRANSITIONS<Mode>[opcode_map][opcode];
+		if (opcode_map == 0 && transition.action == StateMachine::Action::ESCAPE)
+			return ESCAPE;
+		if (opcode_map == 0 && transition.action == StateMachine::Action::PREFIX && (opcode == 0x66 || opcode == 0xF2 || opcode == 0xF3))
+			return LEGACY_PREFIX;
+		if (opcode_map == 0 && transition.action == StateMachine::Action::PREFIX && (transition.argument & Prefixes::REX))
+			return REX_PREFIX;
+
+		// The escape bytes of map 1 and the VEX prefixes of map 0 aren't opcodes either
+		if (transition.action != StateMachine::Action::OPCODE)
+			return DECODE;
+
+		const StateMachine::Descriptor descriptor = StateMachine::LEGACY_DESCRIPTORS[opcode_map][opcode];
+		if (!descriptor.valid || descriptor.modrm == StateMachine::RAW_MODRM || descriptor.group_3 != Opcodes::GROUP_3_NONE)
+			return DECODE;
+
+		const std::uint8_t operand_bits = get_operand_size<Mode>(operand_size == WIDE_OPERANDS, operand_size == OVERRIDDEN_OPERANDS);
+		const std::uint8_t operand_bytes = std::min(operand_bits / 8, 4);
+
+		std::uint8_t tail = descriptor.fixed + descriptor.operand_immediates * operand_bytes;
+		if (descriptor.full_operand_immediate)
+			tail += operand_bits / 8;
+		if (descriptor.displacement == StateMachine::ADDRESS_SIZE_DISPLACEMENT)
+			tail += get_address_size<Mode>(false) / 8;
+		if (descriptor.displacement == StateMachine::MODE_DISPLACEMENT || descriptor.near_branch) {
+			if constexpr (Mode == MachineMode::VIRTUAL8086)
+				tail += 2;
+			else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+				tail += descriptor.near_branch ? operand_bits / 8 : 4;
+			else
+				tail += descriptor.near_branch ? 4 : 8;
+		}
+
+		return KNOWN | (descriptor.modrm == StateMachine::MEMORY_MODRM ? HAS_MODRM : 0) | tail;
+	}
+
+	// Indexed by `operand_size * 512 + opcode_map * 256 + opcode`
+	template <MachineMode Mode>
+	consteval std::array<std::uint8_t, OPERAND_SIZES * 512> build_opcodes()
+	{
+		std::array<std::uint8_t, OPERAND_SIZES * 512> opcodes{};
+
+		for (std::size_t operand_size = 0; operand_size < OPERAND_SIZES; operand_size++)
+			for (std::uint8_t opcode_map = 0; opcode_map < 2; opcode_map++)
+				for (std::size_t opcode = 0; opcode < 256; opcode++)
+					opcodes[operand_size * 512 + opcode_map * 256 + opcode] = describe<Mode>(operand_size, opcode_map, static_cast<std::uint8_t>(opcode));
+
+		return opcodes;
+	}
+
+	template <MachineMode Mode>
+	inline constexpr std::array<std::uint8_t, OPERAND_SIZES * 512> OPCODES = build_opcodes<Mode>();
+
+	// The ModRM byte and the SIB byte and displacement that follow it, indexed by the ModRM byte
+	consteval std::array<std::uint8_t, 256> build_modrm_lengths(const std::array<StateMachine::ModRMLayout, 256>& layouts)
+	{
+		std::array<std::uint8_t, 256> lengths{};
+		for (std::size_t byte = 0; byte < 256; byte++)
+			lengths[byte] = 1 + static_cast<std::uint8_t>(layouts[byte].sib) + layouts[byte].displacement;
+		return lengths;
+	}
+
+	inline constexpr std::array<std::uint8_t, 256> MODRM_LENGTHS_16 = build_modrm_lengths(StateMachine::MODRM_LAYOUTS_16);
+	inline constexpr std::array<std::uint8_t, 256> MODRM_LENGTHS_32 = build_modrm_lengths(StateMachine::MODRM_LAYOUTS_32);
+
+	// The shortcut reads at most a prefix, a REX prefix, the escape byte, the opcode, ModRM and SIB,
+	// and its instructions stay below MAX_INSTRUCTION_LENGTH, so all of them fit as long as that many bytes are readable.
+	constexpr std::size_t LOOKAHEAD = MAX_INSTRUCTION_LENGTH;
+
+	template <MachineMode Mode>
+	consteval std::size_t longest_shortcut()
+	{
+		// A SIB byte without a base only adds its displacement with a ModRM byte that has none, so that never exceeds the longest entry
+		const std::size_t longest_modrm = std::ranges::max(Mode == MachineMode::VIRTUAL8086 ? MODRM_LENGTHS_16 : MODRM_LENGTHS_32);
+
+		std::size_t longest = 0;
+		for (const std::uint8_t entry : OPCODES<Mode>)
+			if (entry & KNOWN)
+				longest = std::max(longest, 4 + (entry & TAIL) + (entry & HAS_MODRM ? longest_modrm : 0));
+		return longest;
+	}
+
+	static_assert(longest_shortcut<MachineMode::VIRTUAL8086>() <= LOOKAHEAD);
+	static_assert(longest_shortcut<MachineMode::LONG_COMPATIBILITY_MODE>() <= LOOKAHEAD);
+	static_assert(longest_shortcut<MachineMode::LONG_MODE>() <= LOOKAHEAD);
+
+	// Returns the length of the instruction at `bytes`, or 0 if it's up to the decoder. LOOKAHEAD bytes have to be readable.
+	template <MachineMode Mode>
+	[[gnu::always_inline]] constexpr std::uint8_t shortcut(const std::byte* bytes)
+	{
+		const auto read = [bytes](std::size_t offset) {
+			return static_cast<std::uint8_t>(bytes[offset]);
+		};
+
+		// Plain opcodes of map 0 take a single lookup, everything else is looked up again once the byte in front of it is known
+		std::size_t position = 0;
+		std::uint8_t entry = OPCODES<Mode>[read(0)];
+		if (!(entry & KNOWN)) {
+			std::size_t operand_size = DEFAULT_OPERANDS;
+			if (entry == LEGACY_PREFIX) {
+				if (read(0) == 0x66)
+					operand_size = OVERRIDDEN_OPERANDS;
+				entry = OPCODES<Mode>[operand_size * 512 + read(++position)];
+			}
+			if (entry == REX_PREFIX) {
+				if (read(position) & 0b1000)
+					operand_size = WIDE_OPERANDS;
+				entry = OPCODES<Mode>[operand_size * 512 + read(++position)];
+			}
+			if (entry == ESCAPE)
+				entry = OPCODES<Mode>[operand_size * 512 + 256 + read(++position)];
+			if (!(entry & KNOWN))
+				return 0;
+		}
+		position++;
+
+		std::size_t length = position + (entry & TAIL);
+		if (entry & HAS_MODRM) {
+			const std::uint8_t modrm = read(position);
+			if constexpr (Mode == MachineMode::VIRTUAL8086) {
+				length += MODRM_LENGTHS_16[modrm];
+			} else {
+				length += MODRM_LENGTHS_32[modrm];
+				// [disp32 + index * scale] without a base
+				if (modrm < 0b01000000 && (modrm & 0b111) == 0b100 && (read(position + 1) & 0b111) == 0b101)
+					length += 4;
+			}
+		}
+
+		return static_cast<std::uint8_t>(length);
+	}
+
+	// The length of the instruction at `bytes`, through the shortcut whenever it knows the instruction and enough bytes are readable
+	template <MachineMode Mode>
+	[[gnu::always_inline]] constexpr std::expected<std::uint8_t, Error> decode_length(const std::byte* bytes, std::uint8_t max_length, std::size_t readable)
+	{
+		if (readable >= LOOKAHEAD)
+			if (const std::uint8_t length = shortcut<Mode>(bytes); length != 0) [[likely]]
+				return length;
+
+		const std::expected<Instruction, Error> result = decode<Mode>(bytes, max_length, readable);
+		if (!result.has_value())
+			return std::unexpected(result.error());
+		return result->length;
+	}
+}
+
+#endif
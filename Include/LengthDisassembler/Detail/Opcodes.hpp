@@ -0,0 +1,182 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_OPCODES_HPP
+#define LENGTHDISASSEMBLER_DETAIL_OPCODES_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "Instrumentation.hpp"
+
+namespace LengthDisassembler::Detail::Opcodes {
+
+	struct [[gnu::packed]] OpcodeInfo {
+		bool modrm : 1;
+
+		std::uint8_t fixed : 3;
+
+		bool disp_asz : 1;
+		bool disp_osz : 1;
+		bool imm_osz : 1;
+		bool uimm_osz : 1;
+	};
+
+	struct [[gnu::packed]] OpcodeInfoRange {
+		std::uint8_t from;
+		std::uint8_t to;
+		OpcodeInfo info;
+	};
+
+	struct [[gnu::packed]] OpcodeTableDefinition {
+		const OpcodeInfoRange* ranges;
+		std::uint8_t len;
+	};
+
+	// The immediate of group 3 (F6 and F7), which only TEST (ModRM.reg 0 and 1) has
+	constexpr std::uint8_t GROUP_3_NONE = 0;
+	constexpr std::uint8_t GROUP_3_BYTE = 1;
+	constexpr std::uint8_t GROUP_3_OSZ = 2;
+
+	// What OpcodeInfo can't express
+	struct SpecialCaseInfo {
+		bool modrm = false;
+		bool modrm_only = false; // The ModRM byte always addresses registers, it is never followed by a SIB byte or a displacement
+		std::uint8_t group_3 = GROUP_3_NONE;
+		bool disp_mode = false; // A displacement of the machine mode's size, regardless of the address size prefix
+		bool rel_mode = false; // A relative branch displacement of 2 bytes in 16-bit mode, of the operand size in 32-bit mode and of 4 bytes in 64-bit mode
+		std::uint8_t fixed = 0;
+		bool legacy_fixed = false; // `fixed` only applies without a VEX prefix
+	};
+
+	struct SpecialCase {
+		std::uint8_t map;
+		std::uint8_t from;
+		std::uint8_t to;
+		SpecialCaseInfo info;
+	};
+
+	// NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define SPECIAL_CASE SpecialCase
+#define SPECIAL_CASE_INFO_DEF(modrm, modrm_only, group_3, disp_mode, rel_mode, fixed, legacy_fixed) \
+	{ modrm, modrm_only, group_3, disp_mode, rel_mode, fixed, legacy_fixed }
+#define SPECIAL_CASE_DEF(map, from, to, info) { map, from, to, info }
+#define OPCODE_INFO_RANGE OpcodeInfoRange
+#define OPCODE_TABLE_DEFINITION OpcodeTableDefinition
+#define OPCODE_INSN_DEF(modrm, fixed, disp_asz, disp_osz, imm_osz, uimm_osz) \
+	{ modrm, fixed, disp_asz, disp_osz, imm_osz, uimm_osz }
+#define RANGE_OPCODE_INSN_DEF(from, to, info) { from, to, info }
+#define OPCODE_TABLE_DEF(table_name, length) { table_name, length }
+	// NOLINTEND(cppcoreguidelines-macro-usage)
+
+#include "GeneratedOpcodeTables.h"
+
+#undef OPCODE_TABLE_DEF
+#undef RANGE_OPCODE_INSN_DEF
+#undef OPCODE_INSN_DEF
+#undef OPCODE_TABLE_DEFINITION 
+#undef OPCODE_INFO_RANGE 
+#undef SPECIAL_CASE_DEF
+#undef SPECIAL_CASE_INFO_DEF
+#undef SPECIAL_CASE
+
+	// Opcodes that encode too many different instructions for XED's patterns to agree on a size are generated as SPECIAL_CASES.
+	// The range tables place a marker right before the first range that covers each of them, which sets both `disp_asz` and `disp_osz`,
+	// as no instruction does, and holds the index into SPECIAL_CASES in `fixed`.
+	// That keeps OpcodeInfo at a single byte, and ordinary instructions only pay for a single test.
+	constexpr bool is_special_case(const OpcodeInfo& info)
+	{
+		return info.disp_asz && info.disp_osz;
+	}
+
+	static_assert(std::size(SPECIAL_CASES) <= 8, "The index of a special case has to fit into OpcodeInfo::fixed");
+
+	// Every special case has exactly one marker, in its map and over its opcodes
+	consteval bool special_cases_are_marked()
+	{
+		std::array<std::size_t, std::size(SPECIAL_CASES)> markers{};
+		for (std::size_t map = 0; map < std::size(OPCODE_TABLES); map++) {
+			for (std::uint8_t i = 0; i < OPCODE_TABLES[map].len; i++) {
+				const OpcodeInfoRange& range = OPCODE_TABLES[map].ranges[i];
+				if (!is_special_case(range.info))
+					continue;
+				if (range.info.fixed >= std::size(SPECIAL_CASES))
+					return false;
+
+				const SpecialCase& special_case = SPECIAL_CASES[range.info.fixed];
+				if (special_case.map != map || special_case.from != range.from || special_case.to != range.to)
+					return false;
+				markers[range.info.fixed]++;
+			}
+		}
+		return std::ranges::all_of(markers, [](std::size_t count) { return count == 1; });
+	}
+
+	static_assert(special_cases_are_marked(), "The generated range tables have to mark every special case once");
+
+	constexpr const SpecialCaseInfo& special_case_of(const OpcodeInfo& info)
+	{
+		assert(is_special_case(info));
+		return SPECIAL_CASES[info.fixed].info;
+	}
+
+	constexpr const OpcodeInfo* lookup_range(std::uint8_t map, std::uint8_t opcode)
+	{
+		if (map >= std::size(OPCODE_TABLES))
+			return nullptr;
+
+		const OpcodeTableDefinition& table = OPCODE_TABLES[map];
+		const OpcodeInfoRange* ranges = table.ranges;
+
+		Instrumentation::count(Instrumentation::Counter::RANGE_LOOKUPS);
+		for (std::uint8_t i = 0; i < table.len; i++) {
+			if (opcode >= ranges[i].from && opcode <= ranges[i].to) {
+				Instrumentation::count(Instrumentation::Counter::RANGE_ENTRIES_SCANNED, i + 1);
+				return &ranges[i].info;
+			}
+		}
+
+		Instrumentation::count(Instrumentation::Counter::RANGE_ENTRIES_SCANNED, table.len);
+		return nullptr;
+	}
+
+#ifdef LENGTHDISASSEMBLER_FAT_OPCODE_TABLES
+	struct FatOpcodeEntry {
+		bool valid;
+		OpcodeInfo info;
+	};
+
+	using FatOpcodeTable = std::array<FatOpcodeEntry, 256>;
+
+	// The direct-indexed tables are expanded from the range tables, so both agree on every opcode, including the gaps that the ranges cover.
+	consteval std::array<FatOpcodeTable, std::size(OPCODE_TABLES)> expand_opcode_tables()
+	{
+		std::array<FatOpcodeTable, std::size(OPCODE_TABLES)> tables{};
+
+		for (std::size_t map = 0; map < tables.size(); map++)
+			for (std::size_t opcode = 0; opcode < 256; opcode++)
+				if (const OpcodeInfo* info = lookup_range(static_cast<std::uint8_t>(map), static_cast<std::uint8_t>(opcode)))
+					tables[map][opcode] = { .valid = true, .info = *info };
+
+		return tables;
+	}
+
+	constexpr std::array<FatOpcodeTable, std::size(OPCODE_TABLES)> FAT_OPCODE_TABLES = expand_opcode_tables();
+#endif
+
+	constexpr const OpcodeInfo* lookup(std::uint8_t map, std::uint8_t opcode)
+	{
+#ifdef LENGTHDISASSEMBLER_FAT_OPCODE_TABLES
+		if (map >= FAT_OPCODE_TABLES.size())
+			return nullptr;
+
+		const FatOpcodeEntry& entry = FAT_OPCODE_TABLES[map][opcode];
+		return entry.valid ? &entry.info : nullptr;
+#else
+		return lookup_range(map, opcode);
+#endif
+	}
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_PARALLELSWEEP_HPP
+#define LENGTHDISASSEMBLER_DETAIL_PARALLELSWEEP_HPP
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+
+namespace LengthDisassembler::Detail {
+	// How `parallel_sweep` and `parallel_sweep_skipping` split their work. The defaults are what the public functions use,
+	// the verifier shrinks them so that its small corpora are split into many chunks as well.
+	struct SweepTuning {
+		std::size_t min_chunk_size = 64 * 1024; // Smaller chunks don't amortize starting a thread
+	};
+
+	std::expected<SweepResult, SweepError> parallel_sweep(
+		std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		MachineMode mode,
+		unsigned threads,
+		const SweepTuning& tuning);
+
+	SweepResult parallel_sweep_skipping(
+		std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		MachineMode mode,
+		unsigned threads,
+		const SweepTuning& tuning);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_PREFIXES_HPP
+#define LENGTHDISASSEMBLER_DETAIL_PREFIXES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace LengthDisassembler::Detail::Prefixes {
+	// Classification of every byte value, a byte can be part of multiple classes
+	constexpr std::uint8_t LEGACY = 1 << 0;
+	constexpr std::uint8_t OPERAND_OVERRIDE = 1 << 1; // 0x66
+	constexpr std::uint8_t ADDRESS_OVERRIDE = 1 << 2; // 0x67
+	constexpr std::uint8_t REX = 1 << 3; // 0b0100xxxx, only a prefix in 64-bit mode
+	constexpr std::uint8_t REX_W = 1 << 4; // REX prefix with the W bit set
+
+	consteval std::array<std::uint8_t, 256> build_classes()
+	{
+		std::array<std::uint8_t, 256> classes{};
+
+		for (const std::uint8_t prefix : {
+				 0xF0, // LOCK
+				 0xF2, // REPNE
+				 0xF3, // REP
+				 0x2E, // CS
+				 0x36, // SS
+				 0x3E, // DS
+				 0x26, // ES
+				 0x64, // FS
+				 0x65, // GS
+				 0x66, // Operand size override
+				 0x67, // Address size override
+			 })
+			classes[prefix] |= LEGACY;
+
+		classes[0x66] |= OPERAND_OVERRIDE;
+		classes[0x67] |= ADDRESS_OVERRIDE;
+
+		for (std::size_t byte = 0x40; byte <= 0x4F; byte++) {
+			classes[byte] |= REX;
+			if ((byte >> 3) & 0b1)
+				classes[byte] |= REX_W;
+		}
+
+		return classes;
+	}
+
+	constexpr std::array<std::uint8_t, 256> CLASSES = build_classes();
+
+	struct Run {
+		std::uint8_t length;
+
+		bool operand_override_prefix;
+		bool address_override_prefix;
+
+		// This is undefined/undocumented. When there are multiple REX prefixes, the last one counts, but
+		// if there is another legacy prefix after the REX prefix, then the REX prefix becomes invalid/is forgotten about.
+		// Thus only the last prefix of the run decides about REX.W.
+		bool operand_size_override;
+	};
+
+	// Returns the amount of consecutive bytes that are part of any class in `accepted`, but at most `max`.
+	constexpr Run scan(const std::byte* bytes, std::uint8_t max, std::uint8_t accepted)
+	{
+		Run run{};
+
+		while (run.length < max) {
+			const std::uint8_t prefix_class = CLASSES[static_cast<std::uint8_t>(bytes[run.length])];
+			if (!(prefix_class & accepted))
+				break;
+
+			run.operand_override_prefix |= (prefix_class & OPERAND_OVERRIDE) != 0;
+			run.address_override_prefix |= (prefix_class & ADDRESS_OVERRIDE) != 0;
+			run.operand_size_override = (prefix_class & REX_W) != 0;
+			run.length++;
+		}
+
+		return run;
+	}
+}
+
+#endif
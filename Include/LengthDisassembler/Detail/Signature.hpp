@@ -0,0 +1,26 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_SIGNATURE_HPP
+#define LENGTHDISASSEMBLER_DETAIL_SIGNATURE_HPP
+
+#include "LengthDisassembler/Signature.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace LengthDisassembler::Detail {
+	// Both ways `Scanner::scan` tests the anchor bytes, so that the verifier can compare them.
+	// Without AVX2, both are the scalar scan.
+	struct ScannerPaths {
+		static std::vector<Signature::Match> scan_scalar(const Signature::Scanner& scanner, std::span<const std::byte> bytes)
+		{
+			return scanner.scan(bytes, false);
+		}
+
+		static std::vector<Signature::Match> scan_vectorized(const Signature::Scanner& scanner, std::span<const std::byte> bytes)
+		{
+			return scanner.scan(bytes, true);
+		}
+	};
+}
+
+#endif
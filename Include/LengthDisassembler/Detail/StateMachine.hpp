@@ -0,0 +1,481 @@
+#ifndef LENGTHDISASSEMBLER_DETAIL_STATEMACHINE_HPP
+#define LENGTHDISASSEMBLER_DETAIL_STATEMACHINE_HPP
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <iterator>
+
+#include "Fields.hpp"
+#include "Instrumentation.hpp"
+#include "Opcodes.hpp"
+#include "Prefixes.hpp"
+
+// An alternative to the hand-written decoder that is driven by tables instead of branches, see LENGTHDISASSEMBLER_STATE_MACHINE_DECODER.
+// Every table is derived at compile time from GeneratedOpcodeTables.h and its special cases, which x86_parser emits as the only description of the opcodes,
+// so both decoders decode every byte sequence the same way and regenerating the header updates both.
+
+namespace LengthDisassembler::Detail::StateMachine {
+	// The state is the opcode map that the next byte belongs to, prefixes are only accepted before the first byte of map 0
+	constexpr std::uint8_t MAP_0 = 0;
+	constexpr std::uint8_t MAP_1 = 1;
+	constexpr std::uint8_t MAP_2 = 2;
+	constexpr std::uint8_t MAP_3 = 3;
+	constexpr std::uint8_t STATE_COUNT = 4;
+
+	enum class Action : std::uint8_t {
+		OPCODE, // The byte is the opcode in the map of the current state
+		PREFIX, // Stay in the current state
+		ESCAPE, // Continue in another map
+		VEX, // C4, C5, 62 and 8F start a VEX, EVEX or XOP prefix, unless the following bytes make them an opcode of map 0
+		THREE_DNOW, // 0F 0F, the opcode follows the ModRM byte and the displacement
+	};
+
+	struct Transition {
+		Action action;
+		std::uint8_t argument; // The next state of an ESCAPE, the Prefixes class of a PREFIX
+	};
+
+	using TransitionTable = std::array<std::array<Transition, 256>, STATE_COUNT>;
+
+	template <MachineMode Mode>
+	consteval TransitionTable build_transitions()
+	{
+		// REX prefixes only exist in 64-bit mode, elsewhere these bytes are INC/DEC
+		constexpr std::uint8_t ACCEPTED = Mode == MachineMode::LONG_MODE
+			? Prefixes::LEGACY | Prefixes::REX
+			: Prefixes::LEGACY;
+
+		TransitionTable transitions{};
+
+		for (std::size_t byte = 0; byte < 256; byte++)
+			if (Prefixes::CLASSES[byte] & ACCEPTED)
+				transitions[MAP_0][byte] = { .action = Action::PREFIX, .argument = Prefixes::CLASSES[byte] };
+
+		transitions[MAP_0][0x0F] = { .action = Action::ESCAPE, .argument = MAP_1 };
+		for (const std::size_t byte : { 0xC4, 0xC5, 0x62, 0x8F })
+			transitions[MAP_0][byte] = { .action = Action::VEX, .argument = 0 };
+
+		transitions[MAP_1][0x0F] = { .action = Action::THREE_DNOW, .argument = 0 };
+		transitions[MAP_1][0x38] = { .action = Action::ESCAPE, .argument = MAP_2 };
+		transitions[MAP_1][0x3A] = { .action = Action::ESCAPE, .argument = MAP_3 };
+
+		return transitions;
+	}
+
+	template <MachineMode Mode>
+	inline constexpr TransitionTable TRANSITIONS = build_transitions<Mode>();
+
+	// How the ModRM byte is decoded
+	constexpr std::uint8_t NO_MODRM = 0;
+	constexpr std::uint8_t MEMORY_MODRM = 1; // Followed by a SIB byte and a displacement as its mode and the address size say
+	constexpr std::uint8_t RAW_MODRM = 2; // MOV CR/DR always address registers, whatever the mode says
+
+	// Where the size of the displacement comes from
+	constexpr std::uint8_t MODRM_DISPLACEMENT = 0;
+	constexpr std::uint8_t ADDRESS_SIZE_DISPLACEMENT = 1; // Absolute memory offset (moffs), there is no ModRM in this case
+	constexpr std::uint8_t MODE_DISPLACEMENT = 2; // A1 purposely ignores prefixes, its offset has the size of the machine mode
+
+	// Control flow that depends on the ModRM byte
+	constexpr std::uint8_t NO_MODRM_FLOW = 0;
+	constexpr std::uint8_t GROUP_5_FLOW = 1; // FF /2 to FF /5
+	constexpr std::uint8_t XBEGIN_FLOW = 2; // XBEGIN shares its opcode with MOV r/m, imm
+
+	// Everything that is known about an instruction once its opcode is, the rest only depends on the ModRM byte and the operand size
+	struct Descriptor {
+		bool valid : 1;
+		std::uint8_t modrm : 2;
+		std::uint8_t displacement : 2;
+		std::uint8_t group_3 : 2;
+
+		std::uint8_t fixed : 3; // Immediate bytes that don't depend on the operand size
+		std::uint8_t operand_immediates : 2; // Immediates and branch displacements of the operand size, up to 4 bytes each
+		bool full_operand_immediate : 1; // An immediate of the full operand size, up to 8 bytes
+		bool near_branch : 1; // CALL/JMP rel16/32, whose displacement depends on the machine mode
+
+		std::uint8_t control_flow : 3; // ControlFlow
+		std::uint8_t modrm_flow : 2;
+	};
+
+	static_assert(sizeof(Descriptor) == 3);
+
+	consteval Descriptor describe(bool is_vex, std::uint8_t opcode_map, std::uint8_t opcode)
+	{
+		Descriptor descriptor{};
+
+		const Opcodes::OpcodeInfo* info = Opcodes::lookup_range(opcode_map, opcode);
+		if (!info)
+			return descriptor;
+
+		descriptor.valid = true;
+
+		if (Opcodes::is_special_case(*info)) {
+			const Opcodes::SpecialCaseInfo& special_case = Opcodes::special_case_of(*info);
+			if (special_case.modrm_only)
+				descriptor.modrm = RAW_MODRM;
+			else if (special_case.modrm)
+				descriptor.modrm = MEMORY_MODRM;
+			if (special_case.disp_mode)
+				descriptor.displacement = MODE_DISPLACEMENT;
+			descriptor.group_3 = special_case.group_3;
+			descriptor.fixed = special_case.legacy_fixed && is_vex ? 0 : special_case.fixed;
+			descriptor.near_branch = special_case.rel_mode;
+			if (!is_vex || special_case.rel_mode)
+				descriptor.control_flow = static_cast<std::uint8_t>(control_flow_of(opcode_map, opcode));
+			return descriptor;
+		}
+
+		descriptor.modrm = info->modrm ? MEMORY_MODRM : NO_MODRM;
+		descriptor.displacement = info->disp_asz ? ADDRESS_SIZE_DISPLACEMENT : MODRM_DISPLACEMENT;
+		descriptor.fixed = info->fixed;
+		descriptor.operand_immediates = static_cast<std::uint8_t>(info->disp_osz) + static_cast<std::uint8_t>(info->imm_osz);
+		descriptor.full_operand_immediate = info->uimm_osz;
+
+		if (!is_vex) {
+			descriptor.control_flow = static_cast<std::uint8_t>(control_flow_of(opcode_map, opcode));
+			if (opcode_map == 0 && info->modrm && opcode == 0xFF)
+				descriptor.modrm_flow = GROUP_5_FLOW;
+			if (opcode_map == 0 && info->modrm && opcode == 0xC7)
+				descriptor.modrm_flow = XBEGIN_FLOW;
+		}
+
+		return descriptor;
+	}
+
+	// Legacy encodings only reach the maps 0 to 3, VEX encodings can select any map of the opcode tables.
+	// The tables are `inline`, so that all translation units share a single copy of them.
+	constexpr std::size_t LEGACY_MAP_COUNT = STATE_COUNT;
+	constexpr std::size_t VEX_MAP_COUNT = std::size(Opcodes::OPCODE_TABLES);
+
+	template <std::size_t MapCount>
+	using DescriptorTable = std::array<std::array<Descriptor, 256>, MapCount>;
+
+	template <std::size_t MapCount>
+	consteval DescriptorTable<MapCount> build_descriptors(bool is_vex)
+	{
+		DescriptorTable<MapCount> descriptors{};
+
+		for (std::size_t map = 0; map < MapCount; map++)
+			for (std::size_t opcode = 0; opcode < 256; opcode++)
+				descriptors[map][opcode] = describe(is_vex, static_cast<std::uint8_t>(map), static_cast<std::uint8_t>(opcode));
+
+		return descriptors;
+	}
+
+	inline constexpr DescriptorTable<LEGACY_MAP_COUNT> LEGACY_DESCRIPTORS = build_descriptors<LEGACY_MAP_COUNT>(false);
+	inline constexpr DescriptorTable<VEX_MAP_COUNT> VEX_DESCRIPTORS = build_descriptors<VEX_MAP_COUNT>(true);
+
+	// What follows a ModRM byte, indexed by the byte itself
+	struct ModRMLayout {
+		bool sib;
+		std::uint8_t displacement;
+	};
+
+	consteval std::array<ModRMLayout, 256> build_modrm_layouts(bool addressing_with_16bit)
+	{
+		std::array<ModRMLayout, 256> layouts{};
+
+		for (std::size_t byte = 0; byte < 256; byte++) {
+			const std::size_t mod = (byte >> 6) & 0b11;
+			const std::size_t rm = byte & 0b111;
+
+			ModRMLayout& layout = layouts[byte];
+			if (addressing_with_16bit) {
+				if (mod == 0b00 && rm == 0b110)
+					layout.displacement = 2;
+				else if (mod == 0b01)
+					layout.displacement = 1;
+				else if (mod == 0b10)
+					layout.displacement = 2;
+				continue;
+			}
+
+			layout.sib = mod != 0b11 && rm == 0b100;
+			if (mod == 0b00 && rm == 0b101)
+				layout.displacement = 4;
+			else if (mod == 0b01)
+				layout.displacement = 1;
+			else if (mod == 0b10)
+				layout.displacement = 4;
+		}
+
+		return layouts;
+	}
+
+	inline constexpr std::array<ModRMLayout, 256> MODRM_LAYOUTS_16 = build_modrm_layouts(true);
+	inline constexpr std::array<ModRMLayout, 256> MODRM_LAYOUTS_32 = build_modrm_layouts(false);
+
+	// Returns how many bytes of a VEX, EVEX or XOP prefix follow its first byte, or 0 if the first byte is an opcode of map 0.
+	// `remaining` is the amount of bytes after the first byte, `second` is only meaningful if there is at least one.
+	template <MachineMode Mode>
+	constexpr std::uint8_t vex_length(std::uint8_t first, std::uint8_t second, std::uint8_t remaining)
+	{
+		// Even the shortest vex (two-byte vex) is 2 bytes long.
+		if (remaining < 1)
+			return 0;
+
+		// VEX.R and VEX.X tell a VEX prefix apart from LES, LDS and BOUND, which always have them cleared
+		if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+			if ((second & 0b11000000) != 0b11000000)
+				return 0;
+
+		switch (first) {
+		case 0xC4:
+			return remaining >= 2 ? 2 : 0;
+		case 0xC5:
+			return 1;
+		case 0x8F:
+			// XOP uses the maps from 8 on to not overlap with POP, its third byte may still be missing
+			return (second & 0b11111) >= 8 ? 2 : 0;
+		case 0x62:
+			return remaining >= 3 ? 3 : 0;
+		default:
+			return 0;
+		}
+	}
+
+	// Past the last prefix or escape byte, at most 7 bytes are read: the rest of an EVEX prefix, the opcode, ModRM and SIB,
+	// or the ModRM and SIB of 3DNow, its 4-byte displacement and the opcode behind it.
+	constexpr std::size_t LOOKAHEAD = 7;
+
+	// Decodes everything after the byte that ended the walk through the transition table, `position` is the offset behind that byte.
+	// Without `Checked`, reads past `max_length` are allowed, with it they read zeros. Either way they leave `index` past `remaining`,
+	// which is checked once at the end, so both result in the same errors as stopping at the first byte that is out of bounds.
+	template <MachineMode Mode, bool Checked>
+	[[gnu::always_inline]] constexpr std::expected<Instruction, Error> decode_after_walk(const std::byte* bytes, std::uint8_t max_length, std::uint8_t position,
+		Action action, std::uint8_t opcode_map, std::uint8_t last, Instruction& instruction)
+	{
+		const std::uint8_t remaining = max_length - position;
+		const std::byte* rest = bytes + position;
+
+		const auto read = [rest, remaining](std::uint8_t offset) -> std::uint8_t {
+			if constexpr (Checked)
+				if (offset >= remaining)
+					return 0;
+			return static_cast<std::uint8_t>(rest[offset]);
+		};
+
+		std::uint8_t index = 0;
+		const auto next = [&read, &index] {
+			return read(index++);
+		};
+
+		if (action == Action::VEX) {
+			const std::uint8_t second = read(0);
+			if (const std::uint8_t length = vex_length<Mode>(last, second, remaining); length != 0) {
+				instruction.is_vex = true;
+				if (last == 0x62)
+					Instrumentation::count(Instrumentation::Counter::EVEX);
+				else if (last == 0x8F)
+					Instrumentation::count(Instrumentation::Counter::XOP);
+				else
+					Instrumentation::count(Instrumentation::Counter::VEX);
+				if (length == 1) {
+					opcode_map = 1;
+				} else {
+					opcode_map = last == 0x62 ? second & 0b111 : second & 0b11111;
+					instruction.operand_size_override = (read(1) >> 7) & 0b1; // VEX.W
+				}
+				index = length;
+				last = next();
+			}
+		}
+
+		instruction.address_bits = get_address_size<Mode>(instruction.address_override_prefix);
+		instruction.operand_bits = get_operand_size<Mode>(instruction.operand_size_override,
+			instruction.operand_override_prefix);
+
+		const std::array<ModRMLayout, 256>& modrm_layouts = instruction.address_bits == 16 ? MODRM_LAYOUTS_16 : MODRM_LAYOUTS_32;
+
+		// Parses a ModRM byte with a memory operand and returns its displacement
+		std::uint8_t modrm = 0;
+		const auto parse_modrm = [&]() -> Displacement {
+			instruction.modrm_offset = position + index;
+
+			modrm = next();
+			const ModRMLayout layout = modrm_layouts[modrm];
+
+			std::uint8_t displacement = layout.displacement;
+			if (layout.sib) {
+				const std::uint8_t sib = next();
+				if (modrm < 0b01000000 && (sib & 0b111) == 0b101)
+					displacement = 4;
+			}
+
+			// 64-bit mode replaces [disp32] with [rip + disp32]
+			if constexpr (Mode == MachineMode::LONG_MODE)
+				instruction.is_rip_relative = (modrm & 0b11000111) == 0b00000101;
+
+			return { .offset = static_cast<std::uint8_t>(position + index), .size = displacement };
+		};
+
+		if (action == Action::THREE_DNOW) {
+			instruction.is_3dnow = true;
+			Instrumentation::count(Instrumentation::Counter::THREE_DNOW);
+
+			Displacement disp = parse_modrm();
+			index += disp.size;
+
+			constexpr std::uint8_t OPCODE_MAP_3D_NOW = 4; // All 3DNOW instructions reside in map 4
+			instruction.opcode_map = OPCODE_MAP_3D_NOW;
+			instruction.opcode = next();
+
+			if (index > remaining)
+				return std::unexpected(Error::NO_MORE_DATA);
+			finish(instruction, position + index, disp, false); // The trailing byte is the opcode
+			return instruction;
+		}
+
+		instruction.opcode_map = opcode_map;
+		instruction.opcode = last;
+
+		Descriptor descriptor{};
+		if (!instruction.is_vex)
+			descriptor = LEGACY_DESCRIPTORS[opcode_map][last];
+		else if (opcode_map < VEX_MAP_COUNT)
+			descriptor = VEX_DESCRIPTORS[opcode_map][last];
+
+		if (!descriptor.valid) {
+			// The opcode may lie past the end
+			if (index > remaining)
+				return std::unexpected(Error::NO_MORE_DATA);
+			return std::unexpected(Error::UNKNOWN_INSTRUCTION);
+		}
+
+		instruction.control_flow = static_cast<ControlFlow>(descriptor.control_flow);
+
+		// Instructions without a displacement have their immediates right after the opcode
+		Displacement disp{ .offset = static_cast<std::uint8_t>(position + index), .size = 0 };
+
+		if (descriptor.modrm == MEMORY_MODRM) {
+			disp = parse_modrm();
+
+			if (descriptor.modrm_flow == GROUP_5_FLOW)
+				instruction.control_flow = control_flow_of_group_5((modrm >> 3) & 0b111);
+			else if (descriptor.modrm_flow == XBEGIN_FLOW && (modrm & 0b11111000) == 0b11111000)
+				instruction.control_flow = ControlFlow::CONDITIONAL_JUMP;
+		} else if (descriptor.modrm == RAW_MODRM) {
+			// MOV CR/DR, take modrm, but just don't care about its displacement...
+			instruction.modrm_offset = position + index;
+			index++;
+			disp.offset = position + index;
+		}
+
+		instruction.is_relative_branch = is_relative_branch(instruction.control_flow);
+
+		if (descriptor.displacement == ADDRESS_SIZE_DISPLACEMENT) {
+			disp.size = instruction.address_bits / 8;
+		} else if (descriptor.displacement == MODE_DISPLACEMENT) {
+			if constexpr (Mode == MachineMode::VIRTUAL8086)
+				disp.size = 2;
+			else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+				disp.size = 4;
+			else
+				disp.size = 8;
+		}
+		index += disp.size;
+
+		const std::uint8_t operand_bytes = std::min(instruction.operand_bits / 8, 4);
+
+		std::uint8_t immediates = descriptor.fixed + descriptor.operand_immediates * operand_bytes;
+		if (descriptor.full_operand_immediate)
+			immediates += instruction.operand_bits / 8;
+		if (descriptor.group_3 != Opcodes::GROUP_3_NONE && ((modrm >> 3) & 0b111) <= 0b001)
+			immediates += descriptor.group_3 == Opcodes::GROUP_3_BYTE ? 1 : operand_bytes;
+		if (descriptor.near_branch) {
+			if constexpr (Mode == MachineMode::VIRTUAL8086)
+				immediates += 2;
+			else if constexpr (Mode == MachineMode::LONG_COMPATIBILITY_MODE)
+				immediates += instruction.operand_bits / 8;
+			else
+				immediates += 4;
+		}
+
+		if (index + immediates > remaining)
+			return std::unexpected(Error::NO_MORE_DATA);
+
+		finish(instruction, position + index + immediates, disp, true);
+		if (instruction.is_relative_branch)
+			instruction.branch_displacement = read_branch_displacement(bytes, instruction);
+		return instruction;
+	}
+
+	// `readable` is the amount of bytes that can be safely read starting at `bytes`, it may exceed `max_length`, which lets the decoder skip its bounds checks.
+	template <MachineMode Mode>
+	[[gnu::always_inline]] constexpr std::expected<Instruction, Error> decode(const std::byte* bytes, std::uint8_t max_length, std::size_t readable)
+	{
+		static_assert(Mode == MachineMode::VIRTUAL8086 || Mode == MachineMode::LONG_COMPATIBILITY_MODE || Mode == MachineMode::LONG_MODE);
+
+		Instruction instruction{
+			.length = 0,
+
+			.opcode_map = 0,
+			.opcode = 0,
+
+			.address_bits = 0,
+			.operand_bits = 0,
+
+			.operand_override_prefix = false,
+			.address_override_prefix = false,
+
+			.operand_size_override = false,
+
+			.is_vex = false,
+			.is_3dnow = false,
+
+			.is_rip_relative = false,
+			.is_relative_branch = false,
+
+			.control_flow = ControlFlow::NONE,
+
+			.modrm_offset = 0,
+			.disp_offset = 0,
+			.disp_size = 0,
+			.imm_offset = 0,
+			.imm_size = 0,
+
+			.branch_displacement = 0,
+		};
+
+		// Prefixes and escape bytes, one lookup per byte until a byte ends the walk
+		const TransitionTable& transitions = TRANSITIONS<Mode>;
+		std::uint8_t state = MAP_0;
+		std::uint8_t position = 0;
+		std::uint8_t last = 0;
+		Transition transition{};
+		while (true) {
+			if (position >= max_length)
+				return std::unexpected(Error::NO_MORE_DATA);
+
+			last = static_cast<std::uint8_t>(bytes[position++]);
+			transition = transitions[state][last];
+
+			if (transition.action == Action::PREFIX) {
+				instruction.operand_override_prefix |= (transition.argument & Prefixes::OPERAND_OVERRIDE) != 0;
+				instruction.address_override_prefix |= (transition.argument & Prefixes::ADDRESS_OVERRIDE) != 0;
+				// Only the last prefix decides about REX.W, see Prefixes::Run
+				instruction.operand_size_override = (transition.argument & Prefixes::REX_W) != 0;
+				continue;
+			}
+			if (transition.action != Action::ESCAPE)
+				break;
+
+			state = transition.argument;
+		}
+
+		// The bounds checks are only needed when the readable bytes end within LOOKAHEAD, e.g. at the end of a sweep
+		if !consteval {
+			if (position + LOOKAHEAD <= readable) [[likely]] {
+				Instrumentation::count(Instrumentation::Counter::UNCHECKED);
+				return decode_after_walk<Mode, false>(bytes, max_length, position, transition.action, state, last, instruction);
+			}
+		}
+		return decode_after_walk<Mode, true>(bytes, max_length, position, transition.action, state, last, instruction);
+	}
+}
+
+#endif
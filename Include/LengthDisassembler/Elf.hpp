@@ -0,0 +1,61 @@
+#ifndef LENGTHDISASSEMBLER_ELF_HPP
+#define LENGTHDISASSEMBLER_ELF_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+namespace LengthDisassembler::Elf {
+	enum class LoadError : std::uint8_t {
+		OPEN_FAILED, // The file couldn't be opened, errno contains the reason.
+		MAPPING_FAILED, // The file couldn't be mapped into memory, errno contains the reason.
+		NOT_ELF, // The file doesn't start with the ELF magic.
+		UNSUPPORTED_MACHINE, // The file is not a little-endian x86 or x86-64 ELF.
+		MALFORMED, // A header points outside the file.
+	};
+
+	struct CodeRange {
+		std::string_view name; // Name of the section, empty when the range was taken from a program header
+		std::uint64_t address; // Virtual address of the first byte
+		std::span<const std::byte> bytes; // Points directly into the mapping
+	};
+
+	// A read-only memory mapping of an ELF file. The code ranges stay valid as long as the file is alive.
+	class File {
+	public:
+		static std::expected<File, LoadError> open(const char* path);
+
+		File(const File&) = delete;
+		File& operator=(const File&) = delete;
+		File(File&& other) noexcept;
+		File& operator=(File&& other) noexcept;
+		~File();
+
+		// Derived from the machine in the ELF header, x86-64 (including x32) is 64-bit, x86 is 32-bit.
+		MachineMode mode() const { return machine_mode; }
+
+		// The executable sections that have contents.
+		// Files without section headers fall back to the executable loadable segments.
+		std::span<const CodeRange> code() const { return code_ranges; }
+
+		// The GNU build ID note, which identifies the exact build of the file, or an empty span if the linker didn't emit one.
+		std::span<const std::byte> build_id() const { return build_id_bytes; }
+
+	private:
+		File() = default;
+
+		void* mapping = nullptr;
+		std::size_t size = 0;
+
+		MachineMode machine_mode = MachineMode::LONG_MODE;
+		std::vector<CodeRange> code_ranges;
+		std::span<const std::byte> build_id_bytes;
+	};
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef LENGTHDISASSEMBLER_INDEX_HPP
+#define LENGTHDISASSEMBLER_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LengthDisassembler/Elf.hpp"
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+namespace LengthDisassembler::Index {
+	// The instruction starts of a single code range, one bit per byte.
+	// Every 512 bits, the amount of starts before them is stored as well, which makes counting and selecting starts logarithmic at worst.
+	class RangeIndex {
+	public:
+		RangeIndex(std::uint64_t address, std::uint64_t size, std::span<const std::uint64_t> bits, std::span<const std::uint64_t> ranks);
+
+		std::uint64_t address() const { return begin; }
+		std::uint64_t size() const { return length; }
+		std::size_t count() const { return static_cast<std::size_t>(ranks.back()); } // The amount of instructions in the range
+
+		bool contains(std::uint64_t address) const { return address - begin < length; }
+		bool is_instruction_start(std::uint64_t address) const;
+
+		// The amount of instruction starts in `[address(), address)`, `address` may be one past the end of the range
+		std::size_t rank(std::uint64_t address) const;
+		// The address of the instruction start with the given index, e.g. `select(rank(address))` is the next start at or after `address`
+		std::optional<std::uint64_t> select(std::size_t index) const;
+
+		// The closest instruction starts after and before `address`, which doesn't have to be a start itself.
+		// `previous_instruction_start(address + 1)` is the start of the instruction that contains `address`.
+		std::optional<std::uint64_t> next_instruction_start(std::uint64_t address) const;
+		std::optional<std::uint64_t> previous_instruction_start(std::uint64_t address) const;
+
+	private:
+		std::uint64_t begin;
+		std::uint64_t length;
+		std::span<const std::uint64_t> bits; // Bit `offset % 64` of `bits[offset / 64]` is set for every instruction start
+		std::span<const std::uint64_t> ranks; // `ranks[block]` is the amount of starts in `bits[0, block * 8)`, the last one is the total
+	};
+
+	enum class LoadError : std::uint8_t {
+		OPEN_FAILED, // The file couldn't be opened, errno contains the reason.
+		MAPPING_FAILED, // The file couldn't be mapped into memory, errno contains the reason.
+		NOT_AN_INDEX, // The file doesn't start with the index magic.
+		UNSUPPORTED_VERSION, // The file has been written by an incompatible version of the library.
+		BUILD_ID_MISMATCH, // The index belongs to a different build of the binary.
+		MALFORMED, // A header points outside the file, or the counts of instruction starts don't match the starts.
+		MISSING_BUILD_ID, // The binary has no build ID, so its index couldn't be told apart from the one of a different build.
+	};
+
+	enum class SaveError : std::uint8_t {
+		OPEN_FAILED, // The file couldn't be created, errno contains the reason.
+		WRITE_FAILED, // The file couldn't be written completely, errno contains the reason.
+	};
+
+	// The instruction starts of all code ranges of a binary. Each range is swept on its own, skipping a single byte whenever an instruction can't be decoded.
+	// An index can be saved to a file and mapped back into memory by the next run, which skips decoding the binary again.
+	// The file is identified by the build ID of the binary, so that an index of a different build is never used.
+	// NOTE: The file is written in the byte order of the host, it is meant to be a cache on the machine that created it.
+	class ModuleIndex {
+	public:
+		// NOTE: Both fail with LoadError::MISSING_BUILD_ID if the build ID is empty.
+		static std::expected<ModuleIndex, LoadError> build(std::span<const Elf::CodeRange> code, MachineMode mode, std::span<const std::byte> build_id, unsigned threads = 0);
+		static std::expected<ModuleIndex, LoadError> build(const Elf::File& file, unsigned threads = 0);
+
+		// NOTE: Fails with LoadError::BUILD_ID_MISMATCH unless the index has been built with the same build ID.
+		static std::expected<ModuleIndex, LoadError> open(const char* path, std::span<const std::byte> build_id);
+		std::expected<void, SaveError> save(const char* path) const;
+
+		// `directory/<hex build ID>.index`, so that every build of a binary has its own file
+		static std::string path_for(std::string_view directory, std::span<const std::byte> build_id);
+
+		ModuleIndex(const ModuleIndex&) = delete;
+		ModuleIndex& operator=(const ModuleIndex&) = delete;
+		ModuleIndex(ModuleIndex&& other) noexcept;
+		ModuleIndex& operator=(ModuleIndex&& other) noexcept;
+		~ModuleIndex();
+
+		MachineMode mode() const { return machine_mode; }
+		std::span<const std::byte> build_id() const;
+		std::span<const RangeIndex> ranges() const { return range_indices; }
+
+		// The range that contains `address`, nullptr if the address isn't code
+		const RangeIndex* find(std::uint64_t address) const;
+
+	private:
+		ModuleIndex() = default;
+
+		// Points into the image and creates the range indices, the image has to be validated already
+		void attach(std::span<const std::uint64_t> image);
+
+		// The whole file, either built in memory or mapped
+		std::vector<std::uint64_t> owned_image;
+		void* mapping = nullptr;
+		std::size_t mapping_size = 0;
+		std::span<const std::uint64_t> image;
+
+		MachineMode machine_mode = MachineMode::LONG_MODE;
+		std::vector<RangeIndex> range_indices; // Sorted by address
+	};
+}
+
+#endif
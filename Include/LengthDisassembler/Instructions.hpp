@@ -0,0 +1,118 @@
+#ifndef LENGTHDISASSEMBLER_INSTRUCTIONS_HPP
+#define LENGTHDISASSEMBLER_INSTRUCTIONS_HPP
+
+#include <cstddef>
+#include <expected>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <span>
+
+#include "LengthDisassembler/Constexpr.hpp"
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+namespace LengthDisassembler {
+	struct DecodedInstruction {
+		std::size_t offset; // Where the instruction starts in the decoded bytes
+		Instruction instruction;
+
+		constexpr bool operator==(const DecodedInstruction&) const = default;
+	};
+
+	// The instructions of `bytes`, decoded back to back and lazily as the range is iterated, e.g.
+	// `instructions(code) | std::views::take_while(...) | std::views::filter(...)`.
+	// The range ends when all bytes have been consumed or when an instruction fails to decode, which the iterator's `error()` tells apart.
+	// Nothing is allocated, every iterator holds the position and the last decoded instruction. As the decoder is inlined from
+	// "LengthDisassembler/Constexpr.hpp", iterating it compiles to the same code as a loop around `disassemble`.
+	class InstructionView : public std::ranges::view_interface<InstructionView> {
+	public:
+		class Iterator {
+		public:
+			using value_type = DecodedInstruction;
+			using difference_type = std::ptrdiff_t;
+			using iterator_concept = std::forward_iterator_tag;
+
+			constexpr Iterator() = default;
+
+			constexpr DecodedInstruction operator*() const { return { .offset = position, .instruction = *current }; }
+
+			constexpr Iterator& operator++()
+			{
+				position += current->length;
+				decode();
+				return *this;
+			}
+
+			constexpr Iterator operator++(int)
+			{
+				Iterator previous = *this;
+				++*this;
+				return previous;
+			}
+
+			// The offset of the next instruction, which is where the range stopped once it has ended
+			constexpr std::size_t offset() const { return position; }
+
+			// Why the range has ended, std::nullopt while it hasn't or when all bytes have been consumed.
+			// NOTE: An instruction that is cut off by the end of `bytes` results in Error::NO_MORE_DATA, like `sweep` does.
+			constexpr std::optional<Error> error() const
+			{
+				if (position == bytes.size() || current.has_value())
+					return std::nullopt;
+				return current.error();
+			}
+
+			friend constexpr bool operator==(const Iterator& left, const Iterator& right) { return left.position == right.position; }
+			friend constexpr bool operator==(const Iterator& iterator, std::default_sentinel_t)
+			{
+				return iterator.position == iterator.bytes.size() || !iterator.current.has_value();
+			}
+
+		private:
+			friend InstructionView;
+
+			constexpr Iterator(std::span<const std::byte> bytes, MachineMode mode)
+				: bytes(bytes)
+				, mode(mode)
+			{
+				decode();
+			}
+
+			constexpr void decode()
+			{
+				if (position != bytes.size())
+					current = disassemble(bytes.subspan(position), mode);
+			}
+
+			std::span<const std::byte> bytes;
+			MachineMode mode = MachineMode::LONG_MODE;
+			std::size_t position = 0;
+			std::expected<Instruction, Error> current;
+		};
+
+		constexpr InstructionView() = default;
+		constexpr InstructionView(std::span<const std::byte> bytes, MachineMode mode)
+			: bytes(bytes)
+			, mode(mode)
+		{
+		}
+
+		constexpr Iterator begin() const { return { bytes, mode }; }
+		constexpr std::default_sentinel_t end() const { return std::default_sentinel; }
+
+	private:
+		std::span<const std::byte> bytes;
+		MachineMode mode = MachineMode::LONG_MODE;
+	};
+
+	constexpr InstructionView instructions(std::span<const std::byte> bytes, MachineMode mode = MachineMode::LONG_MODE)
+	{
+		return { bytes, mode };
+	}
+}
+
+// The iterators only point into the bytes, not into the view
+template <>
+inline constexpr bool std::ranges::enable_borrowed_range<LengthDisassembler::InstructionView> = true;
+
+#endif
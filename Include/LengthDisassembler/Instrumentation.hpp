@@ -0,0 +1,65 @@
+#ifndef LENGTHDISASSEMBLER_INSTRUMENTATION_HPP
+#define LENGTHDISASSEMBLER_INSTRUMENTATION_HPP
+
+#include <cstdint>
+
+#include "LengthDisassembler/Detail/Instrumentation.hpp"
+
+namespace LengthDisassembler {
+	// How often the decoder took its different paths, summed over all threads.
+	// Only counted when built with LENGTHDISASSEMBLER_INSTRUMENTATION, otherwise every counter stays 0.
+	struct Counters {
+		std::uint64_t instructions; // Decoded instructions, including the ones that failed
+		std::uint64_t unchecked; // Instructions that were decoded without bounds checks, as enough bytes were readable behind them
+		std::uint64_t no_more_data; // Instructions that failed with Error::NO_MORE_DATA, usually at the end of a buffer
+		std::uint64_t unknown_instruction; // Instructions that failed with Error::UNKNOWN_INSTRUCTION
+
+		std::uint64_t vex; // Instructions with a two or three byte VEX prefix
+		std::uint64_t evex;
+		std::uint64_t xop;
+		std::uint64_t three_dnow;
+
+		std::uint64_t special_cases; // Opcodes that are decoded from Opcodes::SPECIAL_CASES, only counted by the hand-written decoder
+
+		// Lookups in the range tables and the amount of ranges that they looked at before finding a match or giving up.
+		// Neither the direct-indexed tables nor the state machine decoder look at the range tables at runtime.
+		std::uint64_t range_lookups;
+		std::uint64_t range_entries_scanned;
+	};
+
+	// The counters since the last reset
+	inline Counters snapshot_counters()
+	{
+		using enum Detail::Instrumentation::Counter;
+
+		const Detail::Instrumentation::Totals totals = Detail::Instrumentation::snapshot();
+		const auto get = [&totals](Detail::Instrumentation::Counter counter) {
+			return totals[std::to_underlying(counter)];
+		};
+
+		return {
+			.instructions = get(INSTRUCTIONS),
+			.unchecked = get(UNCHECKED),
+			.no_more_data = get(NO_MORE_DATA),
+			.unknown_instruction = get(UNKNOWN_INSTRUCTION),
+
+			.vex = get(VEX),
+			.evex = get(EVEX),
+			.xop = get(XOP),
+			.three_dnow = get(THREE_DNOW),
+
+			.special_cases = get(SPECIAL_CASES),
+
+			.range_lookups = get(RANGE_LOOKUPS),
+			.range_entries_scanned = get(RANGE_ENTRIES_SCANNED),
+		};
+	}
+
+	// Starts counting from 0 again, on all threads
+	inline void reset_counters()
+	{
+		Detail::Instrumentation::reset();
+	}
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <expected>
+#include <span>
 
 namespace LengthDisassembler {
 	enum class MachineMode : std::uint8_t {
@@ -12,6 +13,18 @@ namespace LengthDisassembler {
 		LONG_MODE, // x86-64
 	};
 
+	// How an instruction affects the flow of execution, so that basic blocks can be split without a full disassembler
+	enum class ControlFlow : std::uint8_t {
+		NONE, // Execution continues with the next instruction.
+		CALL, // CALL rel
+		JUMP, // JMP rel
+		CONDITIONAL_JUMP, // Jcc, LOOPcc, JrCXZ and XBEGIN, which either continue with the next instruction or their relative target.
+		INDIRECT_CALL, // CALL through a register, memory or a far pointer
+		INDIRECT_JUMP, // JMP through a register, memory or a far pointer
+		RETURN, // RET, RETF, IRET, SYSRET and SYSEXIT
+		TRAP, // INT3, INT1, UD0, UD1, UD2 and HLT, execution doesn't continue with the next instruction.
+	};
+
 	struct Instruction {
 		std::uint8_t length;
 
@@ -28,6 +41,22 @@ namespace LengthDisassembler {
 
 		bool is_vex;
 		bool is_3dnow;
+
+		bool is_rip_relative; // Has a memory operand relative to the next instruction (64-bit mode only)
+		bool is_relative_branch; // Has an immediate branch displacement relative to the next instruction
+
+		ControlFlow control_flow;
+
+		// Positions of the encoding fields, relative to the first byte of the instruction
+		std::uint8_t modrm_offset; // 0 if there is no ModRM byte, as it always follows the opcode
+		std::uint8_t disp_offset; // Memory displacement, either after the ModRM/SIB byte or an absolute offset (moffs)
+		std::uint8_t disp_size; // 0 if there is no displacement, in which case `disp_offset` is 0 as well
+		std::uint8_t imm_offset; // All immediates combined, including relative branch displacements
+		std::uint8_t imm_size; // 0 if there are no immediates, in which case `imm_offset` is 0 as well
+
+		std::int32_t branch_displacement; // The sign extended displacement if `is_relative_branch` is set, the target is at `address + length + branch_displacement`
+
+		constexpr bool operator==(const Instruction&) const = default;
 	};
 
 	enum class Error : std::uint8_t {
@@ -38,9 +67,107 @@ namespace LengthDisassembler {
 	constexpr std::uint8_t MAX_INSTRUCTION_LENGTH = 15; // The maximum length of a x86 instruction
 
 	std::expected<Instruction, Error> disassemble(
-		std::byte* bytes,
+		const std::byte* bytes,
 		MachineMode mode = MachineMode::LONG_MODE,
 		std::uint8_t max_length = MAX_INSTRUCTION_LENGTH);
+
+	// Same as above, but specialized for a single machine mode, so that all mode checks are resolved at compile time.
+	template <MachineMode Mode>
+	std::expected<Instruction, Error> disassemble(
+		const std::byte* bytes,
+		std::uint8_t max_length = MAX_INSTRUCTION_LENGTH);
+
+	extern template std::expected<Instruction, Error> disassemble<MachineMode::VIRTUAL8086>(const std::byte*, std::uint8_t);
+	extern template std::expected<Instruction, Error> disassemble<MachineMode::LONG_COMPATIBILITY_MODE>(const std::byte*, std::uint8_t);
+	extern template std::expected<Instruction, Error> disassemble<MachineMode::LONG_MODE>(const std::byte*, std::uint8_t);
+
+	struct SweepResult {
+		std::size_t count; // The amount of instructions that have been decoded
+		std::size_t offset; // The amount of bytes that have been consumed, this is where the next sweep should resume
+	};
+
+	struct SweepError {
+		Error error;
+		std::size_t count; // The amount of instructions that have been decoded before the error occurred
+		std::size_t offset; // The offset of the instruction that failed to decode
+	};
+
+	// Decodes instructions back to back, starting at the beginning of `bytes`, and writes their lengths into `lengths`.
+	// The sweep stops when either all bytes have been consumed or `lengths` is full.
+	// Most lengths are looked up without running the decoder, see "LengthDisassembler/Detail/Lengths.hpp".
+	// NOTE: An instruction that is cut off by the end of `bytes` results in Error::NO_MORE_DATA at its offset.
+	std::expected<SweepResult, SweepError> sweep(
+		std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		MachineMode mode = MachineMode::LONG_MODE);
+
+	// Same as above, but additionally writes the full instruction records into `instructions`.
+	// The sweep stops when either span is full.
+	std::expected<SweepResult, SweepError> sweep(
+		std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		std::span<Instruction> instructions,
+		MachineMode mode = MachineMode::LONG_MODE);
+
+	// Same as the first overload, but splits `bytes` into one chunk per thread, which are decoded concurrently.
+	// Every chunk but the first starts at a guessed instruction boundary, the guesses are corrected afterwards by
+	// decoding from the true end of the previous chunk until both streams meet at the same offset.
+	// The result is exactly the same as the one of `sweep`. Passing 0 threads uses all hardware threads.
+	// Only the bytes that `lengths` can hold instructions for are split, so a small `lengths` doesn't decode the rest of `bytes`.
+	std::expected<SweepResult, SweepError> parallel_sweep(
+		std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		MachineMode mode = MachineMode::LONG_MODE,
+		unsigned threads = 0);
+
+	// Same as above, but skips a single byte whenever an instruction can't be decoded, which is how code with data in between is swept.
+	// A skipped byte is written as a length of 0 and counts as an instruction of the result.
+	// The sweep stops when either all bytes have been consumed or `lengths` is full, a `lengths` as large as `bytes` always suffices.
+	SweepResult parallel_sweep_skipping(
+		std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		MachineMode mode = MachineMode::LONG_MODE,
+		unsigned threads = 0);
+
+	struct StealResult {
+		std::size_t count; // The amount of instructions that have been stolen
+		std::size_t length; // Their combined length, which is at least the requested length
+		bool needs_relocation; // Whether any of them is RIP-relative or a relative branch, which can't be copied as is
+	};
+
+	// Decodes whole instructions from the beginning of `bytes` until they cover at least `min_length` bytes, which is
+	// what needs to be moved into a trampoline to place a detour. The instructions are written into `instructions`,
+	// their `is_rip_relative` and `is_relative_branch` flags tell which of them need to be fixed up after moving them.
+	// NOTE: Running out of either `bytes` or `instructions` before `min_length` is reached results in Error::NO_MORE_DATA.
+	std::expected<StealResult, SweepError> steal(
+		std::span<const std::byte> bytes,
+		std::size_t min_length,
+		std::span<Instruction> instructions,
+		MachineMode mode = MachineMode::LONG_MODE);
+
+	constexpr std::size_t MAX_BACKWARD_WINDOW = 256; // The amount of bytes before an address that are looked at to find its predecessor
+
+	struct Predecessor {
+		std::size_t offset; // Where the instruction starts in `bytes`, it ends where `bytes` ends
+		Instruction instruction;
+		float confidence; // The share of all instruction chains ending at the end of the window that go through this instruction, from 0 to 1
+	};
+
+	// Finds the instruction that ends where `bytes` ends, e.g. the instruction before a crash PC.
+	// Every offset is decoded as a potential instruction start. Following the lengths from there yields chains of instructions,
+	// and all chains that end exactly at the end of `bytes` vote for their last instruction. As x86 instruction streams resynchronize quickly,
+	// most chains that start in the middle of an instruction join the real one, so 64 bytes are usually enough for a clear majority.
+	// NOTE: Only the last MAX_BACKWARD_WINDOW bytes are used. Fails with Error::NO_MORE_DATA if `bytes` is empty, and with
+	// Error::UNKNOWN_INSTRUCTION if no chain ends at the end of `bytes`.
+	std::expected<Predecessor, Error> find_predecessor(
+		std::span<const std::byte> bytes,
+		MachineMode mode = MachineMode::LONG_MODE);
+
+	// Same as above, but only calls are considered, which is what precedes a return address when unwinding a stack.
+	// The confidence is relative to the chains that end in a call.
+	std::expected<Predecessor, Error> find_call_site(
+		std::span<const std::byte> bytes,
+		MachineMode mode = MachineMode::LONG_MODE);
 }
 
 #endif
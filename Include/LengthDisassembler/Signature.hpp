@@ -0,0 +1,124 @@
+#ifndef LENGTHDISASSEMBLER_SIGNATURE_HPP
+#define LENGTHDISASSEMBLER_SIGNATURE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+namespace LengthDisassembler::Detail {
+	struct ScannerPaths;
+}
+
+namespace LengthDisassembler::Signature {
+	// A byte pattern with wildcards, also known as an array of bytes (AOB) signature
+	struct Pattern {
+		std::vector<std::byte> bytes;
+		std::vector<std::byte> mask; // 0xFF for bytes that have to match, 0x00 for wildcards
+
+		// Space separated hex bytes, with `?` or `??` for wildcards, e.g. "48 8B 05 ? ? ? ? C3"
+		static std::optional<Pattern> parse(std::string_view string);
+		std::string to_string() const;
+
+		// `bytes` has to be at least as long as the pattern
+		bool matches(std::span<const std::byte> bytes) const;
+	};
+
+	enum class GenerateError : std::uint8_t {
+		UNDECODABLE, // An instruction couldn't be decoded, e.g. because the offset is not an instruction boundary.
+		NOT_UNIQUE, // The pattern still matches elsewhere after `max_length` bytes, or when reaching the end of the code.
+	};
+
+	// Builds the shortest pattern that starts at `offset` and matches nowhere else in `code`.
+	// The pattern is extended one instruction at a time, bytes that are likely to change between builds are wildcarded:
+	// RIP-relative and absolute memory addresses, as well as relative branch targets.
+	// Outside of 64-bit mode, full size displacements and immediates of 32 bits or more are wildcarded as well, as they are usually addresses.
+	std::expected<Pattern, GenerateError> generate(
+		std::span<const std::byte> code,
+		std::size_t offset,
+		MachineMode mode = MachineMode::LONG_MODE,
+		std::size_t max_length = 64);
+
+	struct Match {
+		std::size_t pattern; // Index into the patterns the scanner was created with
+		std::size_t offset;
+
+		constexpr bool operator==(const Match&) const = default;
+	};
+
+	// Searches for many patterns in a single pass.
+	// Every pattern is reduced to a 3 byte anchor. A position is only looked at when each of its next 3 bytes is in the set
+	// of bytes some anchor has at that place, the sets are tested 32 positions at a time with AVX2 when the CPU supports it.
+	// The remaining positions are looked up in hash tables of the anchors, one for every combination of wildcards in them,
+	// and only compared in full against the patterns found there.
+	class Scanner {
+	public:
+		// Empty patterns never match. Patterns consisting of wildcards only are compared at every offset.
+		explicit Scanner(std::span<const Pattern> patterns);
+
+		// All matches, ordered by offset and then by pattern
+		std::vector<Match> scan(std::span<const std::byte> bytes) const;
+
+	private:
+		friend Detail::ScannerPaths;
+
+		static constexpr std::size_t ANCHOR_LENGTH = 3;
+
+		struct Entry {
+			std::size_t pattern;
+			std::size_t begin; // Into `pattern_bytes` and `pattern_mask`
+			std::size_t length;
+			std::size_t anchor; // Offset of the anchor inside the pattern
+		};
+
+		// A set of 256 bytes, laid out so that it can be tested with byte shuffles.
+		// Bit `high % 8` of `rows[high / 8][low]` tells whether the byte with the nibbles `high` and `low` is in the set.
+		struct ByteSet {
+			alignas(16) std::array<std::array<std::uint8_t, 16>, 2> rows{};
+
+			void insert(std::uint8_t byte) { rows[byte >> 7][byte & 0xF] |= static_cast<std::uint8_t>(1U << (byte >> 4 & 7)); }
+			bool contains(std::uint8_t byte) const { return (rows[byte >> 7][byte & 0xF] >> (byte >> 4 & 7) & 1) != 0; }
+		};
+
+		// A window of the pattern, as little-endian bytes
+		struct Anchor {
+			std::uint32_t value;
+			std::uint32_t mask; // 0xFF for every solid byte
+		};
+
+		// The entries whose anchors have the same solid bytes, grouped by hash
+		struct AnchorTable {
+			std::uint32_t mask;
+			unsigned shift = 0;
+			std::vector<std::size_t> ranges; // `entries[ranges[slot], ranges[slot + 1])` share a slot
+			std::vector<std::size_t> entries; // Indices into `Scanner::entries`
+
+			std::size_t slot(std::uint32_t value) const { return (value * 0x9E3779B1U) >> shift; }
+		};
+
+		// `vectorized` only makes a difference when the CPU supports AVX2
+		std::vector<Match> scan(std::span<const std::byte> bytes, bool vectorized) const;
+
+		void verify(std::span<const std::byte> bytes, std::size_t position, std::vector<Match>& matches) const;
+		void scan_scalar(std::span<const std::byte> bytes, std::size_t position, std::vector<Match>& matches) const;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		std::size_t scan_avx2(std::span<const std::byte> bytes, std::vector<Match>& matches) const;
+#endif
+
+		std::vector<std::byte> pattern_bytes;
+		std::vector<std::byte> pattern_mask;
+		std::vector<Entry> entries;
+
+		std::array<ByteSet, ANCHOR_LENGTH> anchor_sets;
+		std::vector<AnchorTable> anchor_tables; // The tables with the most solid bytes come first
+	};
+}
+
+#endif
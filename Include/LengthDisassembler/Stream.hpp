@@ -0,0 +1,58 @@
+#ifndef LENGTHDISASSEMBLER_STREAM_HPP
+#define LENGTHDISASSEMBLER_STREAM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+namespace LengthDisassembler {
+	// Decodes code that arrives in chunks, e.g. from a pipe or a remote memory reader, with the same result as a single `sweep` over all chunks.
+	// Instructions are decoded in place, only the few bytes at the end of a chunk that may belong to an instruction crossing
+	// into the next chunk are copied into a small carry-over buffer.
+	// An instruction is only decoded once MAX_INSTRUCTION_LENGTH bytes are known behind its start, or once the stream has ended,
+	// as a VEX or EVEX prefix that is cut off decodes as a different instruction.
+	class StreamDecoder {
+	public:
+		explicit StreamDecoder(MachineMode mode = MachineMode::LONG_MODE);
+
+		// Decodes the instructions that are complete with `chunk`, their lengths are written into `lengths`.
+		// The result's `offset` is the amount of bytes of `chunk` that have been consumed, which is less than the whole chunk only
+		// when `lengths` has been filled up, the rest has to be passed again.
+		// NOTE: The offsets of errors are relative to the beginning of the stream. After an error, every call returns it again.
+		std::expected<SweepResult, SweepError> feed(std::span<const std::byte> chunk, std::span<std::uint8_t> lengths);
+
+		// Decodes the instructions that are still waiting for more bytes, as there won't be any.
+		// The result's `offset` is the amount of bytes that have been decoded, call it again if `lengths` has been filled up.
+		// NOTE: An instruction that is cut off by the end of the stream results in Error::NO_MORE_DATA, like `sweep` does.
+		std::expected<SweepResult, SweepError> finish(std::span<std::uint8_t> lengths);
+
+		// The amount of bytes that have to arrive before the next instruction is decoded, 0 if there are no bytes waiting
+		std::size_t needed() const;
+
+		// The offset of the next instruction, relative to the beginning of the stream
+		std::size_t offset() const { return stream_offset; }
+		MachineMode mode() const { return machine_mode; }
+
+	private:
+		template <MachineMode Mode>
+		std::expected<SweepResult, SweepError> feed_impl(std::span<const std::byte> chunk, std::span<std::uint8_t> lengths);
+		template <MachineMode Mode>
+		std::expected<SweepResult, SweepError> finish_impl(std::span<std::uint8_t> lengths);
+
+		// Up to MAX_INSTRUCTION_LENGTH - 1 bytes are left over from a chunk, plus as many of the next chunk as are needed to decode them
+		std::array<std::byte, 2 * MAX_INSTRUCTION_LENGTH - 1> carry;
+		std::size_t carry_begin = 0; // The start of the next instruction in `carry`
+		std::size_t carry_end = 0;
+
+		std::size_t stream_offset = 0;
+		std::optional<SweepError> failure;
+		MachineMode machine_mode;
+	};
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <utility>
+
+#include "LengthDisassembler/Detail/Decoder.hpp"
+
+using namespace LengthDisassembler;
+using Detail::decode;
+
+namespace {
+	bool is_call(const Instruction& instruction)
+	{
+		return instruction.control_flow == ControlFlow::CALL || instruction.control_flow == ControlFlow::INDIRECT_CALL;
+	}
+
+	template <MachineMode Mode, bool OnlyCalls>
+	std::expected<Predecessor, Error> find_predecessor_impl(std::span<const std::byte> bytes)
+	{
+		if (bytes.empty())
+			return std::unexpected(Error::NO_MORE_DATA);
+
+		const std::span<const std::byte> window = bytes.last(std::min(bytes.size(), MAX_BACKWARD_WINDOW));
+
+		// Candidates are identified by their length, which is their distance to the end of the window
+		std::array<Instruction, MAX_INSTRUCTION_LENGTH + 1> candidates;
+		std::array<std::size_t, MAX_INSTRUCTION_LENGTH + 1> votes{};
+		std::array<std::size_t, MAX_INSTRUCTION_LENGTH + 1> earliest_start{};
+
+		// The candidate that the chain starting at an offset ends in, 0 if it doesn't end at the end of the window
+		std::array<std::uint8_t, MAX_BACKWARD_WINDOW> chain_end;
+
+		// Walking backward, the chain of the next instruction has always been resolved already
+		for (std::size_t offset = window.size(); offset-- > 0;) {
+			chain_end[offset] = 0;
+
+			const std::size_t remaining = window.size() - offset;
+			const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
+
+			const std::expected<Instruction, Error> result = decode<Mode>(window.data() + offset, max_length, remaining);
+			if (!result.has_value())
+				continue;
+
+			std::uint8_t candidate;
+			if (result->length == remaining) {
+				if (OnlyCalls && !is_call(result.value()))
+					continue;
+				candidate = result->length;
+				candidates[candidate] = result.value();
+			} else {
+				candidate = chain_end[offset + result->length];
+				if (candidate == 0)
+					continue;
+			}
+
+			chain_end[offset] = candidate;
+			votes[candidate]++;
+			earliest_start[candidate] = offset;
+		}
+
+		// On a tie, the candidate with the longer chain wins
+		std::size_t best = 0;
+		std::size_t total = 0;
+		for (std::size_t candidate = 1; candidate < votes.size(); candidate++) {
+			total += votes[candidate];
+			if (votes[candidate] > votes[best] || (votes[candidate] != 0 && votes[candidate] == votes[best] && earliest_start[candidate] < earliest_start[best]))
+				best = candidate;
+		}
+
+		if (total == 0)
+			return std::unexpected(Error::UNKNOWN_INSTRUCTION);
+
+		return Predecessor{
+			.offset = bytes.size() - best,
+			.instruction = candidates[best],
+			.confidence = static_cast<float>(votes[best]) / static_cast<float>(total),
+		};
+	}
+
+	template <bool OnlyCalls>
+	std::expected<Predecessor, Error> find_predecessor_impl(std::span<const std::byte> bytes, MachineMode mode)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return find_predecessor_impl<MachineMode::VIRTUAL8086, OnlyCalls>(bytes);
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return find_predecessor_impl<MachineMode::LONG_COMPATIBILITY_MODE, OnlyCalls>(bytes);
+		case MachineMode::LONG_MODE:
+			return find_predecessor_impl<MachineMode::LONG_MODE, OnlyCalls>(bytes);
+		default:
+			std::unreachable();
+		}
+	}
+}
+
+std::expected<Predecessor, Error> LengthDisassembler::find_predecessor(std::span<const std::byte> bytes, MachineMode mode)
+{
+	return find_predecessor_impl<false>(bytes, mode);
+}
+
+std::expected<Predecessor, Error> LengthDisassembler::find_call_site(std::span<const std::byte> bytes, MachineMode mode)
+{
+	return find_predecessor_impl<true>(bytes, mode);
+}
@@ -0,0 +1,151 @@
+#include "LengthDisassembler/Boundaries.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "LengthDisassembler/Detail/Lengths.hpp"
+
+using namespace LengthDisassembler;
+
+namespace {
+	template <MachineMode Mode>
+	std::expected<std::uint8_t, Error> decode_length(std::span<const std::byte> code, std::size_t offset)
+	{
+		const std::size_t remaining = code.size() - offset;
+		const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
+
+		return Detail::Lengths::decode_length<Mode>(code.data() + offset, max_length, remaining);
+	}
+
+	// Decodes instructions starting at `offset` until `stop` returns true for the offset of the next instruction, or the code ends.
+	// The offsets of the decoded instructions are passed to `visit`.
+	template <MachineMode Mode, typename Stop, typename Visit>
+	std::expected<std::size_t, SweepError> decode_until(std::span<const std::byte> code, std::size_t offset, Stop&& stop, Visit&& visit)
+	{
+		std::size_t count = 0;
+		while (offset < code.size() && !stop(offset)) {
+			const std::expected<std::uint8_t, Error> length = decode_length<Mode>(code, offset);
+			if (!length.has_value())
+				return std::unexpected(SweepError{ .error = length.error(), .count = count, .offset = offset });
+
+			visit(offset);
+			offset += length.value();
+			count++;
+		}
+		return offset;
+	}
+
+	template <typename Stop, typename Visit>
+	std::expected<std::size_t, SweepError> decode_until(std::span<const std::byte> code, std::size_t offset, MachineMode mode, Stop&& stop, Visit&& visit)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return decode_until<MachineMode::VIRTUAL8086>(code, offset, stop, visit);
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return decode_until<MachineMode::LONG_COMPATIBILITY_MODE>(code, offset, stop, visit);
+		case MachineMode::LONG_MODE:
+			return decode_until<MachineMode::LONG_MODE>(code, offset, stop, visit);
+		default:
+			std::unreachable();
+		}
+	}
+}
+
+BoundaryMap::BoundaryMap(std::size_t size, MachineMode mode)
+	: bits((size + 63) / 64)
+	, region_size(size)
+	, machine_mode(mode)
+{
+}
+
+std::expected<BoundaryMap, SweepError> BoundaryMap::build(std::span<const std::byte> code, MachineMode mode)
+{
+	BoundaryMap map{ code.size(), mode };
+
+	const std::expected<std::size_t, SweepError> end = decode_until(
+		code, 0, mode,
+		[](std::size_t) { return false; },
+		[&map](std::size_t offset) {
+			map.bits[offset / 64] |= std::uint64_t{ 1 } << (offset % 64);
+			map.instruction_count++;
+		});
+	if (!end.has_value())
+		return std::unexpected(end.error());
+
+	return map;
+}
+
+std::size_t BoundaryMap::instruction_start(std::size_t offset) const
+{
+	assert(offset < region_size);
+
+	// The first byte of the region is always a boundary, so this finds one within 15 bytes
+	std::size_t word = offset / 64;
+	std::uint64_t candidates = bits[word] & (~std::uint64_t{ 0 } >> (63 - offset % 64));
+	while (candidates == 0)
+		candidates = bits[--word];
+
+	return word * 64 + 63 - static_cast<std::size_t>(std::countl_zero(candidates));
+}
+
+std::expected<BoundaryChanges, SweepError> BoundaryMap::update(std::span<const std::byte> code, std::size_t offset, std::size_t length)
+{
+	assert(code.size() == region_size);
+	assert(offset + length <= region_size);
+
+	if (length == 0)
+		return BoundaryChanges{ .begin = offset, .end = offset, .added = {}, .removed = {} };
+
+	// The instruction that contains the first patched byte is the first one that may have changed.
+	// Once a new instruction starts at an old boundary past the patch, everything from there on decodes the same as before.
+	const std::size_t patch_end = offset + length;
+	const std::size_t begin = instruction_start(offset);
+
+	std::vector<std::size_t> starts;
+	const std::expected<std::size_t, SweepError> end = decode_until(
+		code, begin, machine_mode,
+		[this, patch_end](std::size_t start) { return start >= patch_end && is_boundary(start); },
+		[&starts](std::size_t start) { starts.push_back(start); });
+	if (!end.has_value())
+		return std::unexpected(end.error());
+
+	BoundaryChanges changes{ .begin = begin, .end = end.value(), .added = {}, .removed = {} };
+
+	// Merge the old boundaries of the range with the new ones, only the ones that aren't in both have changed
+	auto start = starts.begin();
+	for (std::size_t word = begin / 64; word * 64 < changes.end; word++) {
+		std::uint64_t old_bits = bits[word];
+		if (word == begin / 64)
+			old_bits &= ~std::uint64_t{ 0 } << (begin % 64);
+		if ((word + 1) * 64 > changes.end)
+			old_bits &= ~(~std::uint64_t{ 0 } << (changes.end % 64));
+
+		for (; old_bits != 0; old_bits &= old_bits - 1) {
+			const std::size_t old_start = word * 64 + static_cast<std::size_t>(std::countr_zero(old_bits));
+			for (; start != starts.end() && *start < old_start; ++start)
+				changes.added.push_back(*start);
+
+			if (start != starts.end() && *start == old_start)
+				++start;
+			else
+				changes.removed.push_back(old_start);
+		}
+	}
+	changes.added.insert(changes.added.end(), start, starts.end());
+
+	for (const std::size_t removed : changes.removed)
+		bits[removed / 64] &= ~(std::uint64_t{ 1 } << (removed % 64));
+	for (const std::size_t added : changes.added)
+		bits[added / 64] |= std::uint64_t{ 1 } << (added % 64);
+
+	instruction_count = instruction_count + changes.added.size() - changes.removed.size();
+
+	return changes;
+}
@@ -0,0 +1,326 @@
+#include "LengthDisassembler/Elf.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace LengthDisassembler;
+using namespace LengthDisassembler::Elf;
+
+namespace {
+	// Headers are copied out of the mapping, as nothing guarantees their alignment
+	template <typename T>
+	std::optional<T> read(std::span<const std::byte> file, std::uint64_t offset)
+	{
+		if (offset > file.size() || file.size() - offset < sizeof(T))
+			return std::nullopt;
+
+		T value;
+		std::memcpy(&value, file.data() + offset, sizeof(T));
+		return value;
+	}
+
+	std::optional<std::span<const std::byte>> slice(std::span<const std::byte> file, std::uint64_t offset, std::uint64_t size)
+	{
+		if (offset > file.size() || file.size() - offset < size)
+			return std::nullopt;
+
+		return file.subspan(offset, size);
+	}
+
+	std::string_view read_name(std::span<const std::byte> string_table, std::uint32_t offset)
+	{
+		if (offset >= string_table.size())
+			return {};
+
+		const auto* begin = reinterpret_cast<const char*>(string_table.data() + offset);
+		return { begin, ::strnlen(begin, string_table.size() - offset) };
+	}
+
+	template <typename Header, typename SectionHeader, typename ProgramHeader>
+	std::expected<std::vector<CodeRange>, LoadError> find_code(std::span<const std::byte> file)
+	{
+		const std::optional<Header> header = read<Header>(file, 0);
+		if (!header.has_value())
+			return std::unexpected(LoadError::MALFORMED);
+
+		std::vector<CodeRange> code_ranges;
+
+		if (header->e_shoff != 0 && header->e_shentsize == sizeof(SectionHeader)) {
+			const auto section_header = [&](std::uint64_t index) {
+				return read<SectionHeader>(file, header->e_shoff + index * sizeof(SectionHeader));
+			};
+
+			// Files with a lot of sections store the real counts in the first section header
+			const std::optional<SectionHeader> first = section_header(0);
+			if (!first.has_value())
+				return std::unexpected(LoadError::MALFORMED);
+
+			const std::uint64_t section_count = header->e_shnum == 0 ? first->sh_size : header->e_shnum;
+			const std::uint32_t names_index = header->e_shstrndx == SHN_XINDEX ? first->sh_link : header->e_shstrndx;
+
+			std::span<const std::byte> names;
+			if (names_index != SHN_UNDEF) {
+				const std::optional<SectionHeader> names_header = section_header(names_index);
+				if (!names_header.has_value())
+					return std::unexpected(LoadError::MALFORMED);
+
+				const auto names_bytes = slice(file, names_header->sh_offset, names_header->sh_size);
+				if (!names_bytes.has_value())
+					return std::unexpected(LoadError::MALFORMED);
+				names = names_bytes.value();
+			}
+
+			for (std::uint64_t i = 0; i < section_count; i++) {
+				const std::optional<SectionHeader> section = section_header(i);
+				if (!section.has_value())
+					return std::unexpected(LoadError::MALFORMED);
+
+				if (section->sh_type == SHT_NOBITS || !(section->sh_flags & SHF_EXECINSTR) || section->sh_size == 0)
+					continue;
+
+				const auto bytes = slice(file, section->sh_offset, section->sh_size);
+				if (!bytes.has_value())
+					return std::unexpected(LoadError::MALFORMED);
+
+				code_ranges.push_back({
+					.name = read_name(names, section->sh_name),
+					.address = section->sh_addr,
+					.bytes = bytes.value(),
+				});
+			}
+
+			if (section_count != 0)
+				return code_ranges;
+		}
+
+		if (header->e_phoff != 0 && header->e_phentsize == sizeof(ProgramHeader)) {
+			for (std::uint64_t i = 0; i < header->e_phnum; i++) {
+				const std::optional<ProgramHeader> segment = read<ProgramHeader>(file, header->e_phoff + i * sizeof(ProgramHeader));
+				if (!segment.has_value())
+					return std::unexpected(LoadError::MALFORMED);
+
+				if (segment->p_type != PT_LOAD || !(segment->p_flags & PF_X) || segment->p_filesz == 0)
+					continue;
+
+				const auto bytes = slice(file, segment->p_offset, segment->p_filesz);
+				if (!bytes.has_value())
+					return std::unexpected(LoadError::MALFORMED);
+
+				code_ranges.push_back({
+					.name = {},
+					.address = segment->p_vaddr,
+					.bytes = bytes.value(),
+				});
+			}
+		}
+
+		return code_ranges;
+	}
+
+	// Searches a note section or segment for the GNU build ID, an empty span if there is none
+	std::span<const std::byte> find_build_id_note(std::span<const std::byte> notes, std::uint64_t alignment)
+	{
+		const auto align = [alignment](std::uint64_t size) { return (size + alignment - 1) / alignment * alignment; };
+
+		std::uint64_t offset = 0;
+		while (true) {
+			const std::optional<Elf64_Nhdr> note = read<Elf64_Nhdr>(notes, offset); // Elf32_Nhdr has the same layout
+			if (!note.has_value())
+				return {};
+
+			const std::uint64_t name_offset = offset + sizeof(Elf64_Nhdr);
+			const std::uint64_t description_offset = name_offset + align(note->n_namesz);
+
+			const auto name = slice(notes, name_offset, note->n_namesz);
+			const auto description = slice(notes, description_offset, note->n_descsz);
+			if (!name.has_value() || !description.has_value())
+				return {};
+
+			if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == sizeof(ELF_NOTE_GNU) && std::memcmp(name->data(), ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)) == 0)
+				return description.value();
+
+			offset = description_offset + align(note->n_descsz);
+		}
+	}
+
+	template <typename Header, typename SectionHeader, typename ProgramHeader>
+	std::span<const std::byte> find_build_id(std::span<const std::byte> file)
+	{
+		const std::optional<Header> header = read<Header>(file, 0);
+		if (!header.has_value())
+			return {};
+
+		// The note segments survive stripping the section headers
+		if (header->e_phoff != 0 && header->e_phentsize == sizeof(ProgramHeader)) {
+			for (std::uint64_t i = 0; i < header->e_phnum; i++) {
+				const std::optional<ProgramHeader> segment = read<ProgramHeader>(file, header->e_phoff + i * sizeof(ProgramHeader));
+				if (!segment.has_value() || segment->p_type != PT_NOTE)
+					continue;
+
+				const auto notes = slice(file, segment->p_offset, segment->p_filesz);
+				if (!notes.has_value())
+					continue;
+
+				const std::span<const std::byte> build_id = find_build_id_note(notes.value(), segment->p_align == 8 ? 8 : 4);
+				if (!build_id.empty())
+					return build_id;
+			}
+		}
+
+		if (header->e_shoff != 0 && header->e_shentsize == sizeof(SectionHeader)) {
+			for (std::uint64_t i = 0; i < header->e_shnum; i++) {
+				const std::optional<SectionHeader> section = read<SectionHeader>(file, header->e_shoff + i * sizeof(SectionHeader));
+				if (!section.has_value() || section->sh_type != SHT_NOTE)
+					continue;
+
+				const auto notes = slice(file, section->sh_offset, section->sh_size);
+				if (!notes.has_value())
+					continue;
+
+				const std::span<const std::byte> build_id = find_build_id_note(notes.value(), section->sh_addralign == 8 ? 8 : 4);
+				if (!build_id.empty())
+					return build_id;
+			}
+		}
+
+		return {};
+	}
+
+	struct ParsedFile {
+		MachineMode mode;
+		std::vector<CodeRange> code_ranges;
+		std::span<const std::byte> build_id;
+	};
+
+	std::expected<ParsedFile, LoadError> parse(std::span<const std::byte> file)
+	{
+		const std::optional<std::array<unsigned char, EI_NIDENT>> identification = read<std::array<unsigned char, EI_NIDENT>>(file, 0);
+		if (!identification.has_value() || std::memcmp(identification->data(), ELFMAG, SELFMAG) != 0)
+			return std::unexpected(LoadError::NOT_ELF);
+
+		if ((*identification)[EI_DATA] != ELFDATA2LSB)
+			return std::unexpected(LoadError::UNSUPPORTED_MACHINE);
+
+		std::uint16_t machine = 0;
+		std::expected<std::vector<CodeRange>, LoadError> code_ranges;
+		std::span<const std::byte> build_id;
+		switch ((*identification)[EI_CLASS]) {
+		case ELFCLASS32:
+			machine = read<Elf32_Ehdr>(file, 0).value_or(Elf32_Ehdr{}).e_machine;
+			code_ranges = find_code<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>(file);
+			build_id = find_build_id<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>(file);
+			break;
+		case ELFCLASS64:
+			machine = read<Elf64_Ehdr>(file, 0).value_or(Elf64_Ehdr{}).e_machine;
+			code_ranges = find_code<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>(file);
+			build_id = find_build_id<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>(file);
+			break;
+		default:
+			return std::unexpected(LoadError::MALFORMED);
+		}
+
+		MachineMode mode;
+		switch (machine) {
+		case EM_386:
+			mode = MachineMode::LONG_COMPATIBILITY_MODE;
+			break;
+		case EM_X86_64:
+			mode = MachineMode::LONG_MODE;
+			break;
+		default:
+			return std::unexpected(LoadError::UNSUPPORTED_MACHINE);
+		}
+
+		if (!code_ranges.has_value())
+			return std::unexpected(code_ranges.error());
+
+		return ParsedFile{
+			.mode = mode,
+			.code_ranges = std::move(code_ranges.value()),
+			.build_id = build_id,
+		};
+	}
+}
+
+std::expected<File, LoadError> File::open(const char* path)
+{
+	const int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		return std::unexpected(LoadError::OPEN_FAILED);
+
+	struct stat status {};
+	if (::fstat(descriptor, &status) < 0) {
+		::close(descriptor);
+		return std::unexpected(LoadError::OPEN_FAILED);
+	}
+	if (status.st_size <= 0) {
+		::close(descriptor);
+		return std::unexpected(LoadError::NOT_ELF);
+	}
+
+	const auto size = static_cast<std::size_t>(status.st_size);
+	void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	::close(descriptor);
+	if (mapping == MAP_FAILED)
+		return std::unexpected(LoadError::MAPPING_FAILED);
+
+	// Sweeps walk the code front to back
+	(void)::madvise(mapping, size, MADV_SEQUENTIAL);
+
+	File file;
+	file.mapping = mapping;
+	file.size = size;
+
+	auto parsed = parse({ static_cast<const std::byte*>(mapping), size });
+	if (!parsed.has_value())
+		return std::unexpected(parsed.error());
+
+	file.machine_mode = parsed->mode;
+	file.code_ranges = std::move(parsed->code_ranges);
+	file.build_id_bytes = parsed->build_id;
+	return file;
+}
+
+File::File(File&& other) noexcept
+	: mapping(std::exchange(other.mapping, nullptr))
+	, size(std::exchange(other.size, 0))
+	, machine_mode(other.machine_mode)
+	, code_ranges(std::move(other.code_ranges))
+	, build_id_bytes(std::exchange(other.build_id_bytes, {}))
+{
+}
+
+File& File::operator=(File&& other) noexcept
+{
+	if (this != &other) {
+		if (mapping)
+			::munmap(mapping, size);
+
+		mapping = std::exchange(other.mapping, nullptr);
+		size = std::exchange(other.size, 0);
+		machine_mode = other.machine_mode;
+		code_ranges = std::move(other.code_ranges);
+		build_id_bytes = std::exchange(other.build_id_bytes, {});
+	}
+	return *this;
+}
+
+File::~File()
+{
+	if (mapping)
+		::munmap(mapping, size);
+}
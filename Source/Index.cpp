@@ -0,0 +1,478 @@
+#include "LengthDisassembler/Index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+using namespace LengthDisassembler;
+using namespace LengthDisassembler::Index;
+
+namespace {
+	constexpr std::array<char, 8> MAGIC{ 'L', 'D', 'I', 'N', 'D', 'E', 'X', '\0' };
+	constexpr std::uint32_t VERSION = 1;
+
+	constexpr std::size_t WORDS_PER_BLOCK = 8; // One rank per 512 bits
+
+	// The file is a sequence of 64-bit words:
+	// FileHeader, the build ID padded to whole words, a RangeHeader per range, and then the bits and ranks of every range.
+	struct FileHeader {
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t mode;
+		std::uint64_t build_id_size; // In bytes
+		std::uint64_t range_count;
+		std::uint64_t file_size; // In bytes, catches truncated files
+	};
+
+	struct RangeHeader {
+		std::uint64_t address;
+		std::uint64_t size;
+		std::uint64_t bits_offset; // In words from the beginning of the file
+		std::uint64_t ranks_offset;
+	};
+
+	static_assert(sizeof(FileHeader) % sizeof(std::uint64_t) == 0);
+	static_assert(sizeof(RangeHeader) % sizeof(std::uint64_t) == 0);
+
+	constexpr std::size_t FILE_HEADER_WORDS = sizeof(FileHeader) / sizeof(std::uint64_t);
+	constexpr std::size_t RANGE_HEADER_WORDS = sizeof(RangeHeader) / sizeof(std::uint64_t);
+
+	constexpr std::uint64_t words_for_bytes(std::uint64_t bytes) { return (bytes + 7) / 8; }
+	constexpr std::uint64_t words_for_bits(std::uint64_t bits) { return (bits + 63) / 64; }
+	constexpr std::uint64_t ranks_for_words(std::uint64_t words) { return (words + WORDS_PER_BLOCK - 1) / WORDS_PER_BLOCK + 1; }
+
+	// The position of the `n`th set bit, which has to exist
+	std::uint64_t select_in_word(std::uint64_t word, std::uint64_t n)
+	{
+#if defined(__BMI2__)
+		return static_cast<std::uint64_t>(std::countr_zero(_pdep_u64(std::uint64_t{ 1 } << n, word)));
+#else
+		for (; n != 0; n--)
+			word &= word - 1;
+		return static_cast<std::uint64_t>(std::countr_zero(word));
+#endif
+	}
+
+	// Sets a bit for every instruction start, skipping a single byte whenever an instruction can't be decoded.
+	// The range is swept in a single pass, as every byte needs at most one length.
+	void mark_instruction_starts(std::span<const std::byte> bytes, MachineMode mode, unsigned threads, std::span<std::uint64_t> bits)
+	{
+		std::vector<std::uint8_t> lengths(bytes.size());
+		const SweepResult result = parallel_sweep_skipping(bytes, lengths, mode, threads);
+
+		std::size_t offset = 0;
+		for (const std::uint8_t length : std::span{ lengths }.first(result.count)) {
+			if (length == 0) {
+				offset++;
+				continue;
+			}
+
+			bits[offset / 64] |= std::uint64_t{ 1 } << (offset % 64);
+			offset += length;
+		}
+	}
+
+	template <typename T>
+	T read_words(std::span<const std::uint64_t> image, std::size_t offset)
+	{
+		T value;
+		std::memcpy(&value, image.data() + offset, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void write_words(std::span<std::uint64_t> image, std::size_t offset, const T& value)
+	{
+		std::memcpy(image.data() + offset, &value, sizeof(T));
+	}
+
+	// The running counts have to match the bits, `select` relies on them to stay within the bits
+	bool ranks_match_bits(std::span<const std::uint64_t> bits, std::span<const std::uint64_t> ranks, std::uint64_t size)
+	{
+		// Bits past the end of the range would be starts outside of it
+		if (size % 64 != 0 && (bits.back() >> (size % 64)) != 0)
+			return false;
+
+		std::uint64_t rank = 0;
+		for (std::uint64_t word = 0; word < bits.size(); word++) {
+			if (word % WORDS_PER_BLOCK == 0 && ranks[word / WORDS_PER_BLOCK] != rank)
+				return false;
+			rank += static_cast<std::uint64_t>(std::popcount(bits[word]));
+		}
+		return ranks.back() == rank;
+	}
+
+	// Makes sure that every offset in the headers stays within the image, and that the ranks of every range are those of its bits.
+	// NOTE: This reads every word of the image, which is still far cheaper than building the index again.
+	std::expected<void, LoadError> validate(std::span<const std::uint64_t> image, std::span<const std::byte> build_id)
+	{
+		if (build_id.empty())
+			return std::unexpected(LoadError::MISSING_BUILD_ID);
+		if (image.size() < FILE_HEADER_WORDS)
+			return std::unexpected(LoadError::NOT_AN_INDEX);
+
+		const auto header = read_words<FileHeader>(image, 0);
+		if (header.magic != MAGIC)
+			return std::unexpected(LoadError::NOT_AN_INDEX);
+		if (header.version != VERSION)
+			return std::unexpected(LoadError::UNSUPPORTED_VERSION);
+		if (header.file_size != image.size_bytes() || header.mode > static_cast<std::uint32_t>(MachineMode::LONG_MODE))
+			return std::unexpected(LoadError::MALFORMED);
+
+		const std::uint64_t available = image.size() - FILE_HEADER_WORDS;
+		if (header.build_id_size > available * sizeof(std::uint64_t))
+			return std::unexpected(LoadError::MALFORMED);
+
+		const std::span<const std::byte> stored_build_id = std::as_bytes(image.subspan(FILE_HEADER_WORDS)).first(header.build_id_size);
+		if (!std::ranges::equal(stored_build_id, build_id))
+			return std::unexpected(LoadError::BUILD_ID_MISMATCH);
+
+		const std::uint64_t range_headers = FILE_HEADER_WORDS + words_for_bytes(header.build_id_size);
+		if (header.range_count > (image.size() - range_headers) / RANGE_HEADER_WORDS)
+			return std::unexpected(LoadError::MALFORMED);
+
+		for (std::uint64_t i = 0; i < header.range_count; i++) {
+			const auto range = read_words<RangeHeader>(image, range_headers + i * RANGE_HEADER_WORDS);
+
+			// A range can't have more bits than the image, which also keeps `words_for_bits` from wrapping around
+			if (range.size / 64 >= image.size())
+				return std::unexpected(LoadError::MALFORMED);
+
+			const std::uint64_t words = words_for_bits(range.size);
+			if (range.bits_offset > image.size() || image.size() - range.bits_offset < words)
+				return std::unexpected(LoadError::MALFORMED);
+			if (range.ranks_offset > image.size() || image.size() - range.ranks_offset < ranks_for_words(words))
+				return std::unexpected(LoadError::MALFORMED);
+
+			if (!ranks_match_bits(image.subspan(range.bits_offset, words), image.subspan(range.ranks_offset, ranks_for_words(words)), range.size))
+				return std::unexpected(LoadError::MALFORMED);
+		}
+
+		return {};
+	}
+}
+
+RangeIndex::RangeIndex(std::uint64_t address, std::uint64_t size, std::span<const std::uint64_t> bits, std::span<const std::uint64_t> ranks)
+	: begin(address)
+	, length(size)
+	, bits(bits)
+	, ranks(ranks)
+{
+	assert(bits.size() == words_for_bits(size));
+	assert(ranks.size() == ranks_for_words(bits.size()));
+}
+
+bool RangeIndex::is_instruction_start(std::uint64_t address) const
+{
+	if (!contains(address))
+		return false;
+
+	const std::uint64_t offset = address - begin;
+	return (bits[offset / 64] >> (offset % 64) & 1) != 0;
+}
+
+std::size_t RangeIndex::rank(std::uint64_t address) const
+{
+	assert(address >= begin && address - begin <= length);
+
+	const std::uint64_t offset = address - begin;
+	const std::uint64_t word = offset / 64;
+	const std::uint64_t block = word / WORDS_PER_BLOCK;
+
+	std::uint64_t rank = ranks[block];
+	for (std::uint64_t i = block * WORDS_PER_BLOCK; i < word; i++)
+		rank += static_cast<std::uint64_t>(std::popcount(bits[i]));
+	if (offset % 64 != 0)
+		rank += static_cast<std::uint64_t>(std::popcount(bits[word] & ~(~std::uint64_t{ 0 } << (offset % 64))));
+
+	return static_cast<std::size_t>(rank);
+}
+
+std::optional<std::uint64_t> RangeIndex::select(std::size_t index) const
+{
+	if (index >= count())
+		return std::nullopt;
+
+	// The last block that starts with at most `index` starts before it
+	const auto block = static_cast<std::uint64_t>(std::ranges::upper_bound(ranks, std::uint64_t{ index }) - ranks.begin() - 1);
+
+	std::uint64_t remaining = index - ranks[block];
+	for (std::uint64_t word = block * WORDS_PER_BLOCK;; word++) {
+		const auto starts = static_cast<std::uint64_t>(std::popcount(bits[word]));
+		if (remaining < starts)
+			return begin + word * 64 + select_in_word(bits[word], remaining);
+		remaining -= starts;
+	}
+}
+
+std::optional<std::uint64_t> RangeIndex::next_instruction_start(std::uint64_t address) const
+{
+	if (address < begin)
+		return select(0);
+	if (address - begin + 1 >= length)
+		return std::nullopt;
+
+	// Most instructions are short, so the next start tends to be in the same word
+	const std::uint64_t offset = address - begin + 1;
+	const std::uint64_t following = bits[offset / 64] & (~std::uint64_t{ 0 } << (offset % 64));
+	if (following != 0)
+		return begin + offset / 64 * 64 + static_cast<std::uint64_t>(std::countr_zero(following));
+
+	return select(rank(begin + offset));
+}
+
+std::optional<std::uint64_t> RangeIndex::previous_instruction_start(std::uint64_t address) const
+{
+	if (address <= begin)
+		return std::nullopt;
+
+	const std::uint64_t last = std::min(address - begin, length) - 1;
+	const std::uint64_t preceding = bits[last / 64] & (~std::uint64_t{ 0 } >> (63 - last % 64));
+	if (preceding != 0)
+		return begin + last / 64 * 64 + 63 - static_cast<std::uint64_t>(std::countl_zero(preceding));
+
+	const std::size_t rank_before = rank(begin + last / 64 * 64);
+	if (rank_before == 0)
+		return std::nullopt;
+	return select(rank_before - 1);
+}
+
+std::expected<ModuleIndex, LoadError> ModuleIndex::build(std::span<const Elf::CodeRange> code, MachineMode mode, std::span<const std::byte> build_id, unsigned threads)
+{
+	if (build_id.empty())
+		return std::unexpected(LoadError::MISSING_BUILD_ID);
+
+	std::vector<Elf::CodeRange> sorted{ code.begin(), code.end() };
+	std::ranges::sort(sorted, {}, &Elf::CodeRange::address);
+
+	const std::uint64_t range_headers = FILE_HEADER_WORDS + words_for_bytes(build_id.size());
+	std::uint64_t words = range_headers + sorted.size() * RANGE_HEADER_WORDS;
+	for (const Elf::CodeRange& range : sorted) {
+		const std::uint64_t bits = words_for_bits(range.bytes.size());
+		words += bits + ranks_for_words(bits);
+	}
+
+	ModuleIndex index;
+	index.owned_image.resize(words);
+	const std::span<std::uint64_t> image = index.owned_image;
+
+	write_words(image, 0, FileHeader{
+		.magic = MAGIC,
+		.version = VERSION,
+		.mode = static_cast<std::uint32_t>(mode),
+		.build_id_size = build_id.size(),
+		.range_count = sorted.size(),
+		.file_size = image.size_bytes(),
+	});
+	std::ranges::copy(build_id, std::as_writable_bytes(image.subspan(FILE_HEADER_WORDS)).begin());
+
+	std::uint64_t data = range_headers + sorted.size() * RANGE_HEADER_WORDS;
+	for (std::size_t i = 0; i < sorted.size(); i++) {
+		const Elf::CodeRange& range = sorted[i];
+
+		const std::uint64_t bit_words = words_for_bits(range.bytes.size());
+		const RangeHeader header{
+			.address = range.address,
+			.size = range.bytes.size(),
+			.bits_offset = data,
+			.ranks_offset = data + bit_words,
+		};
+		write_words(image, range_headers + i * RANGE_HEADER_WORDS, header);
+
+		const std::span<std::uint64_t> bits = image.subspan(header.bits_offset, bit_words);
+		const std::span<std::uint64_t> ranks = image.subspan(header.ranks_offset, ranks_for_words(bit_words));
+		mark_instruction_starts(range.bytes, mode, threads, bits);
+
+		std::uint64_t rank = 0;
+		for (std::uint64_t word = 0; word < bit_words; word++) {
+			if (word % WORDS_PER_BLOCK == 0)
+				ranks[word / WORDS_PER_BLOCK] = rank;
+			rank += static_cast<std::uint64_t>(std::popcount(bits[word]));
+		}
+		ranks.back() = rank;
+
+		data += bit_words + ranks.size();
+	}
+
+	index.attach(image);
+	return index;
+}
+
+std::expected<ModuleIndex, LoadError> ModuleIndex::build(const Elf::File& file, unsigned threads)
+{
+	return build(file.code(), file.mode(), file.build_id(), threads);
+}
+
+std::expected<ModuleIndex, LoadError> ModuleIndex::open(const char* path, std::span<const std::byte> build_id)
+{
+	const int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		return std::unexpected(LoadError::OPEN_FAILED);
+
+	struct stat status {};
+	if (::fstat(descriptor, &status) < 0) {
+		::close(descriptor);
+		return std::unexpected(LoadError::OPEN_FAILED);
+	}
+	if (status.st_size <= 0 || status.st_size % sizeof(std::uint64_t) != 0) {
+		::close(descriptor);
+		return std::unexpected(LoadError::NOT_AN_INDEX);
+	}
+
+	const auto size = static_cast<std::size_t>(status.st_size);
+	void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	::close(descriptor);
+	if (mapping == MAP_FAILED)
+		return std::unexpected(LoadError::MAPPING_FAILED);
+
+	ModuleIndex index;
+	index.mapping = mapping;
+	index.mapping_size = size;
+
+	const std::span<const std::uint64_t> image{ static_cast<const std::uint64_t*>(mapping), size / sizeof(std::uint64_t) };
+	if (const std::expected<void, LoadError> valid = validate(image, build_id); !valid.has_value())
+		return std::unexpected(valid.error());
+
+	index.attach(image);
+	return index;
+}
+
+std::expected<void, SaveError> ModuleIndex::save(const char* path) const
+{
+	// Write to a uniquely named file in the same directory first, so that a concurrent `open` never sees a partial index
+	// and concurrent saves never write into the same file. The rename then replaces the index in a single step.
+	std::string temporary = std::string{ path } + ".XXXXXX";
+
+	const int descriptor = ::mkostemp(temporary.data(), O_CLOEXEC);
+	if (descriptor < 0)
+		return std::unexpected(SaveError::OPEN_FAILED);
+	// mkostemp creates the file for the owner only, but the index is as readable as any other cache
+	::fchmod(descriptor, 0644);
+
+	const std::span<const std::byte> bytes = std::as_bytes(image);
+	std::size_t written = 0;
+	while (written < bytes.size()) {
+		const ssize_t result = ::write(descriptor, bytes.data() + written, bytes.size() - written);
+		if (result <= 0) {
+			::close(descriptor);
+			::unlink(temporary.c_str());
+			return std::unexpected(SaveError::WRITE_FAILED);
+		}
+		written += static_cast<std::size_t>(result);
+	}
+
+	// Without syncing, a crash after the rename could leave an empty or partial file behind under the final name
+	if (::fsync(descriptor) < 0) {
+		::close(descriptor);
+		::unlink(temporary.c_str());
+		return std::unexpected(SaveError::WRITE_FAILED);
+	}
+
+	if (::close(descriptor) < 0 || std::rename(temporary.c_str(), path) != 0) {
+		::unlink(temporary.c_str());
+		return std::unexpected(SaveError::WRITE_FAILED);
+	}
+	return {};
+}
+
+std::string ModuleIndex::path_for(std::string_view directory, std::span<const std::byte> build_id)
+{
+	constexpr std::string_view DIGITS = "0123456789abcdef";
+
+	std::string path{ directory };
+	if (!path.empty() && path.back() != '/')
+		path += '/';
+	for (const std::byte byte : build_id) {
+		path += DIGITS[std::to_integer<std::size_t>(byte >> 4)];
+		path += DIGITS[std::to_integer<std::size_t>(byte & std::byte{ 0xF })];
+	}
+	path += ".index";
+	return path;
+}
+
+ModuleIndex::ModuleIndex(ModuleIndex&& other) noexcept
+	: owned_image(std::move(other.owned_image))
+	, mapping(std::exchange(other.mapping, nullptr))
+	, mapping_size(std::exchange(other.mapping_size, 0))
+	, image(std::exchange(other.image, {}))
+	, machine_mode(other.machine_mode)
+	, range_indices(std::move(other.range_indices))
+{
+}
+
+ModuleIndex& ModuleIndex::operator=(ModuleIndex&& other) noexcept
+{
+	if (this != &other) {
+		if (mapping)
+			::munmap(mapping, mapping_size);
+
+		owned_image = std::move(other.owned_image);
+		mapping = std::exchange(other.mapping, nullptr);
+		mapping_size = std::exchange(other.mapping_size, 0);
+		image = std::exchange(other.image, {});
+		machine_mode = other.machine_mode;
+		range_indices = std::move(other.range_indices);
+	}
+	return *this;
+}
+
+ModuleIndex::~ModuleIndex()
+{
+	if (mapping)
+		::munmap(mapping, mapping_size);
+}
+
+std::span<const std::byte> ModuleIndex::build_id() const
+{
+	const auto header = read_words<FileHeader>(image, 0);
+	return std::as_bytes(image.subspan(FILE_HEADER_WORDS)).first(header.build_id_size);
+}
+
+const RangeIndex* ModuleIndex::find(std::uint64_t address) const
+{
+	// The last range that starts at or before `address`
+	const auto after = std::ranges::upper_bound(range_indices, address, {}, &RangeIndex::address);
+	if (after == range_indices.begin())
+		return nullptr;
+
+	const RangeIndex& range = *(after - 1);
+	return range.contains(address) ? &range : nullptr;
+}
+
+void ModuleIndex::attach(std::span<const std::uint64_t> image)
+{
+	this->image = image;
+
+	const auto header = read_words<FileHeader>(image, 0);
+	machine_mode = static_cast<MachineMode>(header.mode);
+
+	const std::uint64_t range_headers = FILE_HEADER_WORDS + words_for_bytes(header.build_id_size);
+	range_indices.clear();
+	range_indices.reserve(header.range_count);
+	for (std::uint64_t i = 0; i < header.range_count; i++) {
+		const auto range = read_words<RangeHeader>(image, range_headers + i * RANGE_HEADER_WORDS);
+		const std::uint64_t words = words_for_bits(range.size);
+		range_indices.emplace_back(range.address, range.size, image.subspan(range.bits_offset, words), image.subspan(range.ranks_offset, ranks_for_words(words)));
+	}
+}
@@ -2,611 +2,308 @@
 
 #include <algorithm>
 #include <array>
-#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <expected>
-#include <optional>
+#include <iterator>
+#include <ranges>
+#include <span>
 #include <utility>
 
-#include "ByteStream.hpp"
-#include "Opcodes.hpp"
-
-// NOTE: If you plan on reading through this entire code, please start at the LengthDisassembler::disassemble function
+#include "LengthDisassembler/Constexpr.hpp"
+#include "LengthDisassembler/Detail/Decoder.hpp"
+#include "LengthDisassembler/Detail/Lengths.hpp"
+#include "LengthDisassembler/Instructions.hpp"
 
 using namespace LengthDisassembler;
+using Detail::decode;
+
+// Make sure the decoder stays usable in constant expressions
+namespace {
+	constexpr std::array PUSH_RBP_MOV_RBP_RSP{ std::byte{ 0x55 }, std::byte{ 0x48 }, std::byte{ 0x89 }, std::byte{ 0xE5 } };
+	static_assert(disassemble<MachineMode::LONG_MODE>(PUSH_RBP_MOV_RBP_RSP)->length == 1);
+	static_assert(disassemble(std::span{ PUSH_RBP_MOV_RBP_RSP }.subspan(1))->length == 3);
+	static_assert(disassemble(std::span{ PUSH_RBP_MOV_RBP_RSP }.subspan(1, 2)).error() == Error::NO_MORE_DATA);
+
+	constexpr std::array LEA_RAX_RIP{ std::byte{ 0x48 }, std::byte{ 0x8D }, std::byte{ 0x05 }, std::byte{ 0x78 }, std::byte{ 0x56 }, std::byte{ 0x34 }, std::byte{ 0x12 } };
+	static_assert(disassemble<MachineMode::LONG_MODE>(LEA_RAX_RIP)->is_rip_relative);
+	static_assert(!disassemble<MachineMode::LONG_COMPATIBILITY_MODE>(std::span{ LEA_RAX_RIP }.subspan(1))->is_rip_relative);
+	static_assert(disassemble<MachineMode::LONG_MODE>(LEA_RAX_RIP)->modrm_offset == 2);
+	static_assert(disassemble<MachineMode::LONG_MODE>(LEA_RAX_RIP)->disp_offset == 3);
+	static_assert(disassemble<MachineMode::LONG_MODE>(LEA_RAX_RIP)->disp_size == 4);
+	static_assert(disassemble<MachineMode::LONG_MODE>(LEA_RAX_RIP)->imm_size == 0);
+
+	constexpr std::array MOV_ECX_IMM32{ std::byte{ 0xB9 }, std::byte{ 0x78 }, std::byte{ 0x56 }, std::byte{ 0x34 }, std::byte{ 0x12 } };
+	static_assert(disassemble<MachineMode::LONG_MODE>(MOV_ECX_IMM32)->modrm_offset == 0);
+	static_assert(disassemble<MachineMode::LONG_MODE>(MOV_ECX_IMM32)->imm_offset == 1);
+	static_assert(disassemble<MachineMode::LONG_MODE>(MOV_ECX_IMM32)->imm_size == 4);
+	static_assert(disassemble<MachineMode::LONG_MODE>(MOV_ECX_IMM32)->control_flow == ControlFlow::NONE);
+
+	constexpr std::array CALL_REL32{ std::byte{ 0xE8 }, std::byte{ 0xFB }, std::byte{ 0xFF }, std::byte{ 0xFF }, std::byte{ 0xFF } };
+	static_assert(disassemble<MachineMode::LONG_MODE>(CALL_REL32)->control_flow == ControlFlow::CALL);
+	static_assert(disassemble<MachineMode::LONG_MODE>(CALL_REL32)->branch_displacement == -5);
+
+	constexpr std::array JNZ_REL8_RET{ std::byte{ 0x75 }, std::byte{ 0x7F }, std::byte{ 0xC3 } };
+	static_assert(disassemble<MachineMode::LONG_MODE>(JNZ_REL8_RET)->control_flow == ControlFlow::CONDITIONAL_JUMP);
+	static_assert(disassemble<MachineMode::LONG_MODE>(JNZ_REL8_RET)->branch_displacement == 127);
+	static_assert(disassemble(std::span{ JNZ_REL8_RET }.subspan(2))->control_flow == ControlFlow::RETURN);
+
+	constexpr std::array CALL_RAX_JMP_RAX{ std::byte{ 0xFF }, std::byte{ 0xD0 }, std::byte{ 0xFF }, std::byte{ 0xE0 } };
+	static_assert(disassemble<MachineMode::LONG_MODE>(CALL_RAX_JMP_RAX)->control_flow == ControlFlow::INDIRECT_CALL);
+	static_assert(disassemble(std::span{ CALL_RAX_JMP_RAX }.subspan(2))->control_flow == ControlFlow::INDIRECT_JUMP);
+	static_assert(disassemble(std::span{ CALL_RAX_JMP_RAX }.subspan(2))->branch_displacement == 0);
+
+	// The fast path skips the bounds checks when enough bytes are readable, it has to agree with the checked path on every truncation
+	template <MachineMode Mode, std::size_t N>
+	constexpr bool decodes_identically(const std::array<std::byte, N>& bytes)
+	{
+		std::array<std::byte, N + MAX_INSTRUCTION_LENGTH> padded{};
+		std::ranges::copy(bytes, padded.begin());
 
-// NOLINTBEGIN(cppcoreguidelines-macro-usage, bugprone-macro-parentheses, cppcoreguidelines-avoid-do-while)
-#define PROPAGATE_RESULT_AND_DEFINE(name, result)         \
-	decltype((result))::value_type name;                  \
-	do {                                                  \
-		if (auto _result = (result); _result.has_value()) \
-			name = _result.value();                       \
-		else                                              \
-			return std::unexpected(_result.error());      \
-	} while (0)
-#define PROPAGATE_RESULT(result)                           \
-	do {                                                   \
-		if (auto _result = (result); !_result.has_value()) \
-			return std::unexpected(_result.error());       \
-	} while (0)
-#define NO_MORE_DATA_IF(result)                          \
-	do {                                                 \
-		if ((result))                                    \
-			return std::unexpected(Error::NO_MORE_DATA); \
-	} while (0)
-// NOLINTEND(cppcoreguidelines-macro-usage, bugprone-macro-parentheses, cppcoreguidelines-avoid-do-while)
-
-static bool parse_rex_prefix(std::uint8_t byte, bool& operand_size_override)
-{
-	// Check that bits follow the pattern 0b0100xxxx
-	const bool has_rex = (byte & 0b11110000) == 0b01000000;
-
-	if (has_rex)
-		operand_size_override = (byte >> 3) & 0b1; // REX.W
-
-	return has_rex;
-};
-
-static std::uint8_t legacy_prefixes[]{
-	0xF0,
-	0xF2,
-	0xF3,
-
-	0x2E,
-	0x36,
-	0x3E,
-	0x26,
-	0x64,
-	0x65,
-	0x2E,
-	0x3E,
-
-	0x66,
-
-	0x67,
-};
-
-static void count_prefixes(ByteStream& bytes,
-	bool& operand_override_prefix,
-	bool& address_override_prefix,
-	bool& operand_size_override,
-	bool search_for_rex_prefix)
-{
-	while (!bytes.empty()) {
-		const std::uint8_t next = bytes.peek().value();
-		if (std::uint8_t* it = std::ranges::find(legacy_prefixes, next);
-			it != std::end(legacy_prefixes)) {
-			if (*it == 0x66)
-				operand_override_prefix = true;
-			if (*it == 0x67)
-				address_override_prefix = true;
-
-			// This is undefined/undocumented. When there are multiple REX prefixes, the last one counts, but
-			// if there is another legacy prefix after the REX prefix, then the REX prefix becomes invalid/is forgotten about.
-			operand_size_override = false;
-
-			bytes.next();
-			continue;
-		}
-
-		if (search_for_rex_prefix && parse_rex_prefix(next, operand_size_override)) {
-			bytes.next();
-			continue;
-		}
-
-		break;
-	}
-}
-
-static std::expected<void, Error> parse_opcode(ByteStream& bytes, std::uint8_t& opcode, std::uint8_t& opcode_map)
-{
-	auto first = bytes.next();
-	if (first.has_value() && first != 0x0F) {
-		opcode = first.value();
-		opcode_map = 0;
-		return {};
+		for (std::uint8_t length = 0; length <= N; length++)
+			if (decode<Mode>(padded.data(), length, padded.size()) != decode<Mode>(bytes.data(), length, length))
+				return false;
+		return true;
 	}
 
-	auto second = bytes.next();
-	if (second.has_value() && second != 0x38 && second != 0x3A) {
-		opcode = second.value();
-		opcode_map = 1;
-		return {};
-	}
+	static_assert(decodes_identically<MachineMode::LONG_MODE>(LEA_RAX_RIP));
+	static_assert(decodes_identically<MachineMode::LONG_MODE>(CALL_REL32));
+	static_assert(decodes_identically<MachineMode::VIRTUAL8086>(CALL_REL32));
 
-	auto third = bytes.next();
-	NO_MORE_DATA_IF(!third);
+	// 14 prefixes leave a single byte for the instruction
+	constexpr std::array PREFIXED_NOP{ std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x66 }, std::byte{ 0x90 } };
+	static_assert(decodes_identically<MachineMode::LONG_MODE>(PREFIXED_NOP));
 
-	opcode = third.value();
-	opcode_map = second == 0x38 ? 2 : 3;
-	return {};
-}
+	// vpaddd zmm0{k1}, zmm1, [rax + 0x40], where the EVEX prefix alone is 4 bytes
+	constexpr std::array VPADDD_EVEX{ std::byte{ 0x62 }, std::byte{ 0xF1 }, std::byte{ 0x75 }, std::byte{ 0x49 }, std::byte{ 0xFE }, std::byte{ 0x40 }, std::byte{ 0x01 } };
+	static_assert(decodes_identically<MachineMode::LONG_MODE>(VPADDD_EVEX));
+	static_assert(decodes_identically<MachineMode::LONG_COMPATIBILITY_MODE>(VPADDD_EVEX));
 
-struct SIB {
-	std::uint8_t scale : 2;
-	std::uint8_t index : 3;
-	std::uint8_t base : 3;
+	// pfadd mm0, [rax], 3DNow! has its opcode at the end
+	constexpr std::array PFADD_3DNOW{ std::byte{ 0x0F }, std::byte{ 0x0F }, std::byte{ 0x00 }, std::byte{ 0x9E } };
+	static_assert(decodes_identically<MachineMode::LONG_MODE>(PFADD_3DNOW));
 
-	std::expected<void, Error> parse(ByteStream& bytes)
+	// Whichever decoder is selected, the other one has to decode the same
+	template <MachineMode Mode, std::size_t N>
+	constexpr bool decoders_agree(const std::array<std::byte, N>& bytes)
 	{
-		const std::optional<std::uint8_t> optional = bytes.next();
-		NO_MORE_DATA_IF(!optional);
-		const std::uint8_t byte = optional.value();
-
-		*this = {
-			.scale = static_cast<std::uint8_t>((byte >> 6) & 0b11),
-			.index = static_cast<std::uint8_t>((byte >> 3) & 0b111),
-			.base = static_cast<std::uint8_t>((byte >> 0) & 0b111)
-		};
-
-		return {};
+		for (std::uint8_t length = 0; length <= N; length++)
+			if (Detail::StateMachine::decode<Mode>(bytes.data(), length, length) != Detail::decode_handwritten<Mode>(bytes.data(), length, length))
+				return false;
+		return true;
 	}
-};
 
-struct ModRM {
-	std::uint8_t mod : 2;
-	std::uint8_t reg : 3;
-	std::uint8_t rm : 3;
-
-	std::expected<void, Error> parse(ByteStream& bytes,
-		std::uint8_t& displacement,
-		bool addressing_with_16bit)
+	static_assert(decoders_agree<MachineMode::LONG_MODE>(LEA_RAX_RIP));
+	static_assert(decoders_agree<MachineMode::LONG_MODE>(CALL_REL32));
+	static_assert(decoders_agree<MachineMode::VIRTUAL8086>(CALL_REL32));
+	static_assert(decoders_agree<MachineMode::LONG_MODE>(CALL_RAX_JMP_RAX));
+	static_assert(decoders_agree<MachineMode::LONG_MODE>(PREFIXED_NOP));
+	static_assert(decoders_agree<MachineMode::LONG_MODE>(VPADDD_EVEX));
+	static_assert(decoders_agree<MachineMode::LONG_COMPATIBILITY_MODE>(VPADDD_EVEX));
+	static_assert(decoders_agree<MachineMode::LONG_MODE>(PFADD_3DNOW));
+
+	// The shortcut of lengths-only sweeps has to agree with the decoder on what it knows, and leave the rest to it
+	template <MachineMode Mode, std::size_t N>
+	constexpr bool shortcut_agrees(const std::array<std::byte, N>& bytes)
 	{
-		const std::optional<std::uint8_t> optional = bytes.next();
-		NO_MORE_DATA_IF(!optional);
-		const std::uint8_t byte = optional.value();
-
-		*this = {
-			.mod = static_cast<std::uint8_t>((byte >> 6) & 0b11),
-			.reg = static_cast<std::uint8_t>((byte >> 3) & 0b111),
-			.rm = static_cast<std::uint8_t>((byte >> 0) & 0b111),
-		};
-
-		if (addressing_with_16bit) {
-			switch (mod) {
-			case 0b00:
-				if (rm == 0b110)
-					displacement = 4;
-				break;
-			case 0b01:
-				displacement = 1;
-				break;
-			case 0b10:
-				displacement = 2;
-				break;
-			default:
-				break;
-			}
-
-			return {};
-		}
-
-		SIB sib{};
-
-		if (mod != 0b11 && rm == 0b100) {
-			PROPAGATE_RESULT(sib.parse(bytes));
-		}
-
-		switch (mod) {
-		case 0b00:
-			if (rm == 0b101)
-				// TODO alert user that there is a relative displacement (if on 64 bit)
-				displacement = 4;
-
-			if (sib.base == 0b101)
-				displacement = 4;
-			break;
-		case 0b01:
-			displacement = 1;
-			break;
-		case 0b10:
-			displacement = 4;
-			break;
-		default:
-			break;
-		}
-
-		return {};
-	}
-};
-
-enum class VexType : std::uint8_t {
-	TWO_BYTE,
-	THREE_BYTE,
-	// This thing must be the greatest invention AMD ever brought forward.
-	THREE_BYTE_XOP,
-	EVEX,
-};
-
-static std::optional<VexType> type_of_vex(MachineMode mode, const ByteStream& bytes)
-{
-	if (!bytes.has(2)) {
-		// Even the shortest vex (two-byte vex) is 2 bytes long.
-		return std::nullopt;
-	}
+		std::array<std::byte, Detail::Lengths::LOOKAHEAD> padded{};
+		std::ranges::copy(bytes, padded.begin());
 
-	using enum VexType;
-
-	if (mode == MachineMode::LONG_COMPATIBILITY_MODE) {
-		// Some opcodes may clash with VEX, for example 0x62 is also the opcode for BOUND
-		// To disambiguate Intel suggests checking the bits of the next byte
-		// The VEX.R (first bit) is useless as only 8 registers are available.
-		// Thus VEX.R is used to check if the byte is a EVEX or a BOUND in this case
-		const std::uint8_t vex1 = bytes.peek(1).value();
-		const std::uint8_t vex_r = (vex1 >> 7) & 0b1;
-		// Just checking VEX.R does not work, X also needs to be checked, not sure if this is enough.
-		const std::uint8_t vex_x = (vex1 >> 6) & 0b1;
-
-		if (vex_r == 0 || vex_x == 0)
-			// TODO is this correct?
-			return std::nullopt;
+		const std::uint8_t length = Detail::Lengths::shortcut<Mode>(padded.data());
+		return length == 0 || length == decode<Mode>(padded.data(), MAX_INSTRUCTION_LENGTH, padded.size())->length;
 	}
 
-	const std::uint8_t vex_byte = bytes.peek().value();
-	switch (vex_byte) {
-	case 0xC4:
-		if (bytes.has(3))
-			return THREE_BYTE;
-
-		break;
-	case 0xC5:
-		// The top of the function already verifies at least 2 bytes
-		return TWO_BYTE;
-	case 0x8F: {
-		const std::uint8_t opcode_map = bytes.peek(1).value() & 0b11111;
-		if (opcode_map >= 8) // Prevent it from overlapping with other instructions...
-			return THREE_BYTE_XOP;
-
-		break;
+	static_assert(Detail::Lengths::shortcut<MachineMode::LONG_MODE>(LEA_RAX_RIP.data()) == LEA_RAX_RIP.size());
+	static_assert(Detail::Lengths::shortcut<MachineMode::LONG_MODE>(MOV_ECX_IMM32.data()) == MOV_ECX_IMM32.size());
+	static_assert(shortcut_agrees<MachineMode::LONG_MODE>(CALL_REL32));
+	static_assert(shortcut_agrees<MachineMode::VIRTUAL8086>(CALL_REL32));
+	static_assert(shortcut_agrees<MachineMode::LONG_MODE>(JNZ_REL8_RET));
+	static_assert(shortcut_agrees<MachineMode::LONG_MODE>(CALL_RAX_JMP_RAX));
+	static_assert(Detail::Lengths::shortcut<MachineMode::LONG_MODE>(VPADDD_EVEX.data()) == 0);
+	static_assert(Detail::Lengths::shortcut<MachineMode::LONG_MODE>(PREFIXED_NOP.data()) == 0);
+
+	// The lazy view has to work with the standard range adaptors and end cleanly at the end of the bytes as well as on errors
+	static_assert(std::ranges::forward_range<InstructionView> && std::ranges::view<InstructionView>);
+	static_assert(std::ranges::distance(instructions(PUSH_RBP_MOV_RBP_RSP)) == 2);
+	static_assert(std::ranges::distance(instructions(std::span{ PUSH_RBP_MOV_RBP_RSP }.first(3))) == 1);
+	static_assert(std::ranges::next(instructions(std::span{ PUSH_RBP_MOV_RBP_RSP }.first(3)).begin(), std::default_sentinel).error() == Error::NO_MORE_DATA);
+	static_assert(!std::ranges::next(instructions(PUSH_RBP_MOV_RBP_RSP).begin(), std::default_sentinel).error().has_value());
+	static_assert((*std::ranges::next(instructions(JNZ_REL8_RET).begin())).offset == 2);
+
+	constexpr bool takes_until_return(std::span<const std::byte> bytes, std::size_t expected_count)
+	{
+		const auto body = instructions(bytes) | std::views::take_while([](const DecodedInstruction& decoded) {
+			return decoded.instruction.control_flow != ControlFlow::RETURN;
+		});
+		return std::ranges::distance(body) == static_cast<std::ptrdiff_t>(expected_count);
 	}
-	case 0x62:
-		if (bytes.has(4))
-			return EVEX;
-
-		break;
-	default:;
-	};
-	return std::nullopt;
-}
-
-static std::uint8_t parse_two_byte_vex(ByteStream& bytes, std::uint8_t& opcode_map)
-{
-	assert(bytes.has(2));
-
-	const std::uint8_t b = bytes.next().value();
-	assert(b == 0xC5);
-
-	opcode_map = 0b00001;
-
-	(void)bytes.next();
-	return 2;
-}
-
-static std::uint8_t parse_three_byte_vex(ByteStream& bytes,
-	std::uint8_t& opcode_map,
-	bool& operand_size_override)
-{
-	assert(bytes.has(3));
-
-	const std::uint8_t b = bytes.next().value();
-	assert(b == 0xC4);
-
-	opcode_map = bytes.next().value() & 0b11111;
-
-	operand_size_override = (bytes.next().value() >> 7) & 0b1; // VEX.W
 
-	return 3;
+	static_assert(takes_until_return(JNZ_REL8_RET, 1));
+	static_assert(takes_until_return(CALL_RAX_JMP_RAX, 2));
 }
 
-static std::uint8_t parse_three_byte_xop(ByteStream& bytes,
-	std::uint8_t& opcode_map,
-	bool& operand_size_override)
+template <MachineMode Mode>
+std::expected<Instruction, Error> LengthDisassembler::disassemble(const std::byte* bytes, std::uint8_t max_length)
 {
-	assert(bytes.has(3));
-
-	const std::uint8_t b = bytes.next().value();
-	assert(b == 0x8F);
-
-	opcode_map = bytes.next().value() & 0b11111;
-
-	// The AMD64 Architecture Programmer’s Manual Volume 6 states that the map_select field must be equal to or greater than 8, to differentiate the XOP prefix from the POP instruction that formerly used opcode 0x8F.
-	assert(opcode_map >= 8);
-
-	operand_size_override = (bytes.next().value() >> 7) & 0b1; // VEX.W
-
-	return 3;
+	return decode<Mode>(bytes, max_length, max_length);
 }
 
-static std::uint8_t parse_evex(ByteStream& bytes,
-	std::uint8_t& opcode_map,
-	bool& operand_size_override)
-{
-	assert(bytes.has(4));
-
-	const std::uint8_t b = bytes.next().value();
-	assert(b == 0x62);
-
-	opcode_map = bytes.next().value() & 0b111;
+template std::expected<Instruction, Error> LengthDisassembler::disassemble<MachineMode::VIRTUAL8086>(const std::byte*, std::uint8_t);
+template std::expected<Instruction, Error> LengthDisassembler::disassemble<MachineMode::LONG_COMPATIBILITY_MODE>(const std::byte*, std::uint8_t);
+template std::expected<Instruction, Error> LengthDisassembler::disassemble<MachineMode::LONG_MODE>(const std::byte*, std::uint8_t);
 
-	operand_size_override = (bytes.next().value() >> 7) & 0b1; // VEX.W
-
-	(void)bytes.next();
-
-	return 4;
-}
-
-static bool is_3dnow(const ByteStream& bytes)
+std::expected<Instruction, Error> LengthDisassembler::disassemble(const std::byte* bytes, MachineMode mode, std::uint8_t max_length)
 {
-	return bytes.has(2) && bytes.peek() == 0x0F && bytes.peek(1) == 0x0F;
+	switch (mode) {
+	case MachineMode::VIRTUAL8086:
+		return decode<MachineMode::VIRTUAL8086>(bytes, max_length, max_length);
+	case MachineMode::LONG_COMPATIBILITY_MODE:
+		return decode<MachineMode::LONG_COMPATIBILITY_MODE>(bytes, max_length, max_length);
+	case MachineMode::LONG_MODE:
+		return decode<MachineMode::LONG_MODE>(bytes, max_length, max_length);
+	default:
+		std::unreachable();
+	}
 }
 
-static std::expected<void, Error> handle_3dnow(ByteStream& bytes, bool addressing_with_16bit, std::uint8_t& map, std::uint8_t& opcode)
+template <MachineMode Mode, bool WithInstructions>
+static std::expected<SweepResult, SweepError> sweep_impl(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	std::span<Instruction> instructions)
 {
-	const bool had_0f_0f = bytes.consume(2); // 0x0F0F
-	assert(had_0f_0f);
-
-	std::uint8_t displacement = 0;
-	PROPAGATE_RESULT(ModRM{}.parse(bytes, displacement, addressing_with_16bit));
-	NO_MORE_DATA_IF(!bytes.consume(displacement));
-
-	static constexpr std::uint8_t OPCODE_MAP_3D_NOW = 4; // All 3DNOW instructions reside in map 4
-	map = OPCODE_MAP_3D_NOW;
+	const std::byte* const begin = bytes.data();
+	const std::byte* const end = begin + bytes.size();
+
+	std::size_t capacity = lengths.size();
+	if constexpr (WithInstructions)
+		capacity = std::min(capacity, instructions.size());
+
+	const std::byte* cursor = begin;
+	std::size_t count = 0;
+
+	while (count < capacity && cursor < end) {
+		const auto remaining = static_cast<std::size_t>(end - cursor);
+		const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
+
+		// Without instructions to fill in, most lengths come from the shortcut
+		std::expected<std::uint8_t, Error> length;
+		if constexpr (WithInstructions) {
+			const std::expected<Instruction, Error> result = decode<Mode>(cursor, max_length, remaining);
+			if (result.has_value()) {
+				instructions[count] = result.value();
+				length = result->length;
+			} else {
+				length = std::unexpected(result.error());
+			}
+		} else {
+			length = Detail::Lengths::decode_length<Mode>(cursor, max_length, remaining);
+		}
 
-	if (auto opcode_byte = bytes.next(); opcode_byte.has_value()) {
-		opcode = opcode_byte.value();
+		if (!length.has_value()) {
+			return std::unexpected(SweepError{
+				.error = length.error(),
+				.count = count,
+				.offset = static_cast<std::size_t>(cursor - begin),
+			});
+		}
 
-		return {};
+		lengths[count] = length.value();
+		cursor += length.value();
+		count++;
 	}
 
-	return std::unexpected(Error::NO_MORE_DATA);
+	return SweepResult{
+		.count = count,
+		.offset = static_cast<std::size_t>(cursor - begin),
+	};
 }
 
-/*
- * Address and Operands size overrides in Long 64-bit mode:
- *      REX.W   Prefix  Operand     Address
- *      0       No      32-bit      64-bit
- *      0       Yes     16-bit      32-bit
- *      1       No      64-bit[1]   64-bit
- *      1       Yes     64-bit      32-bit
- *
- * [1] Some instructions don't need REX.W for 64-bit operands
- *
- *
- * Long compatibility mode:
- *
- *      Prefix  Operand     Address
- *      No      32-bit      32-bit
- *      Yes     16-bit      16-bit
- */
-
-// TODO, when VEX implies 0x66 prefix, does that count?
-
-static std::uint8_t get_address_size(MachineMode mode, bool prefix)
+std::expected<SweepResult, SweepError> LengthDisassembler::sweep(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	MachineMode mode)
 {
 	switch (mode) {
 	case MachineMode::VIRTUAL8086:
-		return prefix ? 32 : 16;
+		return sweep_impl<MachineMode::VIRTUAL8086, false>(bytes, lengths, {});
 	case MachineMode::LONG_COMPATIBILITY_MODE:
-		return prefix ? 16 : 32;
+		return sweep_impl<MachineMode::LONG_COMPATIBILITY_MODE, false>(bytes, lengths, {});
 	case MachineMode::LONG_MODE:
-		return prefix ? 32 : 64;
+		return sweep_impl<MachineMode::LONG_MODE, false>(bytes, lengths, {});
 	default:
 		std::unreachable();
 	}
 }
 
-static std::uint8_t get_operand_size(MachineMode mode, bool rex_w, bool prefix)
+std::expected<SweepResult, SweepError> LengthDisassembler::sweep(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	std::span<Instruction> instructions,
+	MachineMode mode)
 {
 	switch (mode) {
 	case MachineMode::VIRTUAL8086:
-		return prefix ? 32 : 16;
+		return sweep_impl<MachineMode::VIRTUAL8086, true>(bytes, lengths, instructions);
 	case MachineMode::LONG_COMPATIBILITY_MODE:
-		return prefix ? 16 : 32;
+		return sweep_impl<MachineMode::LONG_COMPATIBILITY_MODE, true>(bytes, lengths, instructions);
 	case MachineMode::LONG_MODE:
-		if (!rex_w)
-			return prefix ? 16 : 32;
-		return 64;
+		return sweep_impl<MachineMode::LONG_MODE, true>(bytes, lengths, instructions);
 	default:
 		std::unreachable();
 	}
 }
 
-static std::expected<bool, Error> handle_instructions_explicitly(ByteStream& stream, Instruction& instruction, MachineMode mode)
-{
-	const bool addressing_with_16bit = instruction.address_bits == 16;
-
-	if (instruction.opcode == 0xf7 && instruction.opcode_map == 0) {
-		std::uint8_t displacement = 0;
-		ModRM modrm{};
-		PROPAGATE_RESULT(modrm.parse(stream, displacement, addressing_with_16bit));
-		NO_MORE_DATA_IF(!stream.consume(displacement));
-		if (modrm.reg == 0b0000 || modrm.reg == 0b0001) {
-			const std::uint8_t bytes = std::min(instruction.operand_bits / 8, 4);
-			NO_MORE_DATA_IF(!stream.consume(bytes));
-		}
-		return true;
-	}
-	if (instruction.opcode == 0xf6 && instruction.opcode_map == 0) {
-		std::uint8_t displacement = 0;
-		ModRM modrm{};
-		PROPAGATE_RESULT(modrm.parse(stream, displacement, addressing_with_16bit));
-		NO_MORE_DATA_IF(!stream.consume(displacement));
-		if (modrm.reg == 0b0000 || modrm.reg == 0b0001) {
-			NO_MORE_DATA_IF(!stream.next());
-		}
-		return true;
-	}
-	if (instruction.opcode == 0xa1 && instruction.opcode_map == 0) {
-		// This instruction purposely ignores prefixes...
-		switch (mode) {
-		case MachineMode::VIRTUAL8086:
-			NO_MORE_DATA_IF(!stream.consume(2));
-			break;
-		case MachineMode::LONG_COMPATIBILITY_MODE:
-			NO_MORE_DATA_IF(!stream.consume(4));
-			break;
-		case MachineMode::LONG_MODE:
-			NO_MORE_DATA_IF(!stream.consume(8));
-			break;
-		default:
-			std::unreachable();
-		}
-
-		return true;
-	}
-	if (instruction.opcode == 0x78 && instruction.opcode_map == 1) {
-		if (!instruction.is_vex) {
-			// VMREAD or EXTRQ or INSERTQ
-			// TODO check that its not VMREAD
-			std::uint8_t displacement = 0;
-			ModRM modrm{};
-			PROPAGATE_RESULT(modrm.parse(stream, displacement, addressing_with_16bit));
-			NO_MORE_DATA_IF(!stream.consume(displacement));
-			NO_MORE_DATA_IF(!stream.consume(2)); // two 1-byte immediate
-			return true;
-		}
-	}
-	if (instruction.opcode_map == 0 && (instruction.opcode == 0xe8 || instruction.opcode == 0xe9)) {
-		switch (mode) {
-		case MachineMode::VIRTUAL8086:
-			NO_MORE_DATA_IF(!stream.consume(2));
-			break;
-		case MachineMode::LONG_COMPATIBILITY_MODE:
-			NO_MORE_DATA_IF(!stream.consume(instruction.operand_bits / 8));
-			break;
-		case MachineMode::LONG_MODE:
-			// TODO: Alert user that there is a relative offset
-			NO_MORE_DATA_IF(!stream.consume(4));
-			break;
-		default:
-			std::unreachable();
-		}
-		return true;
-	}
-	if (instruction.opcode_map == 1 && (instruction.opcode == 0x20 || instruction.opcode == 0x21)) {
-		// MOV CR/DR, take modrm, but just don't care about its displacement...
-		NO_MORE_DATA_IF(!stream.next());
-		return true;
-	}
-
-	return false;
-}
-
-std::expected<Instruction, Error> LengthDisassembler::disassemble(std::byte* bytes, MachineMode mode, std::uint8_t max_length)
+template <MachineMode Mode>
+static std::expected<StealResult, SweepError> steal_impl(std::span<const std::byte> bytes,
+	std::size_t min_length,
+	std::span<Instruction> instructions)
 {
-	ByteStream stream{ bytes, static_cast<std::uint8_t>(max_length + 1) };
-
-	Instruction instruction{
+	StealResult stolen{
+		.count = 0,
 		.length = 0,
-
-		.opcode_map = 0,
-		.opcode = 0,
-
-		.address_bits = 0,
-		.operand_bits = 0,
-
-		.operand_override_prefix = false,
-		.address_override_prefix = false,
-
-		.operand_size_override = false,
-
-		.is_vex = false,
-		.is_3dnow = false,
+		.needs_relocation = false,
 	};
 
-	count_prefixes(stream,
-		instruction.operand_override_prefix,
-		instruction.address_override_prefix,
-		instruction.operand_size_override,
-		mode == MachineMode::LONG_MODE);
-
-	NO_MORE_DATA_IF(stream.empty());
-
-	if (const std::optional<VexType> type = type_of_vex(mode, stream); type.has_value()) {
-		instruction.is_vex = true;
-		switch (type.value()) {
-			using enum VexType;
-		case TWO_BYTE:
-			parse_two_byte_vex(stream, instruction.opcode_map);
-			break;
-		case THREE_BYTE:
-			parse_three_byte_vex(stream, instruction.opcode_map, instruction.operand_size_override);
-			break;
-		case THREE_BYTE_XOP:
-			parse_three_byte_xop(stream, instruction.opcode_map, instruction.operand_size_override);
-			break;
-		case EVEX:
-			parse_evex(stream, instruction.opcode_map, instruction.operand_size_override);
-			break;
-		default:
-			std::unreachable();
-		}
-		if (std::optional<std::uint8_t> optional = stream.next(); optional.has_value()) {
-			instruction.opcode = optional.value();
-		} else {
-			return std::unexpected(Error::NO_MORE_DATA);
+	while (stolen.length < min_length) {
+		if (stolen.count == instructions.size() || stolen.length == bytes.size()) {
+			return std::unexpected(SweepError{
+				.error = Error::NO_MORE_DATA,
+				.count = stolen.count,
+				.offset = stolen.length,
+			});
 		}
-	}
 
-	instruction.address_bits = get_address_size(mode, instruction.address_override_prefix);
-	instruction.operand_bits = get_operand_size(mode,
-		instruction.operand_size_override,
-		instruction.operand_override_prefix);
+		const std::size_t remaining = bytes.size() - stolen.length;
+		const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
 
-	const bool addressing_with_16bit = instruction.address_bits == 16;
-
-	if (!instruction.is_vex) {
-		if (is_3dnow(stream)) {
-			instruction.is_3dnow = true;
-			PROPAGATE_RESULT(handle_3dnow(stream, addressing_with_16bit, instruction.opcode_map, instruction.opcode));
-			instruction.length = stream.offset();
-			return instruction;
+		const std::expected<Instruction, Error> result = decode<Mode>(bytes.data() + stolen.length, max_length, remaining);
+		if (!result.has_value()) {
+			return std::unexpected(SweepError{
+				.error = result.error(),
+				.count = stolen.count,
+				.offset = stolen.length,
+			});
 		}
 
-		PROPAGATE_RESULT(parse_opcode(stream, instruction.opcode, instruction.opcode_map));
-	}
-
-	PROPAGATE_RESULT_AND_DEFINE(explicitly_handled, handle_instructions_explicitly(stream, instruction, mode));
-	if (explicitly_handled) {
-		instruction.length = stream.offset();
-		return instruction;
-	}
-
-	const Opcodes::OpcodeInfo* info = Opcodes::lookup(instruction.opcode_map, instruction.opcode);
-
-	if (!info) {
-		return std::unexpected(Error::UNKNOWN_INSTRUCTION);
-	}
-
-	std::uint8_t displacement = 0;
-	if (info->modrm) {
-		PROPAGATE_RESULT(ModRM{}.parse(stream, displacement, addressing_with_16bit));
+		instructions[stolen.count++] = result.value();
+		stolen.length += result->length;
+		stolen.needs_relocation |= result->is_rip_relative || result->is_relative_branch;
 	}
 
-	if (info->disp_asz) {
-		NO_MORE_DATA_IF(!stream.consume(instruction.address_bits / 8));
-	}
-
-	if (info->disp_osz) {
-		const std::uint8_t bytes = std::min(instruction.operand_bits / 8, 4);
-		NO_MORE_DATA_IF(!stream.consume(bytes));
-	}
-
-	NO_MORE_DATA_IF(!stream.consume(displacement));
-
-	NO_MORE_DATA_IF(!stream.consume(info->fixed));
-
-	if (info->imm_osz) {
-		const std::uint8_t bytes = std::min(instruction.operand_bits / 8, 4);
-		NO_MORE_DATA_IF(!stream.consume(bytes));
-	}
+	return stolen;
+}
 
-	if (info->uimm_osz) {
-		const std::uint8_t bytes = instruction.operand_bits / 8;
-		NO_MORE_DATA_IF(!stream.consume(bytes));
+std::expected<StealResult, SweepError> LengthDisassembler::steal(std::span<const std::byte> bytes,
+	std::size_t min_length,
+	std::span<Instruction> instructions,
+	MachineMode mode)
+{
+	switch (mode) {
+	case MachineMode::VIRTUAL8086:
+		return steal_impl<MachineMode::VIRTUAL8086>(bytes, min_length, instructions);
+	case MachineMode::LONG_COMPATIBILITY_MODE:
+		return steal_impl<MachineMode::LONG_COMPATIBILITY_MODE>(bytes, min_length, instructions);
+	case MachineMode::LONG_MODE:
+		return steal_impl<MachineMode::LONG_MODE>(bytes, min_length, instructions);
+	default:
+		std::unreachable();
 	}
-
-	instruction.length = stream.offset();
-	return instruction;
 }
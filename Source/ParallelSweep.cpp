@@ -0,0 +1,203 @@
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "LengthDisassembler/Detail/Lengths.hpp"
+#include "LengthDisassembler/Detail/ParallelSweep.hpp"
+
+using namespace LengthDisassembler;
+using Detail::Lengths::decode_length;
+
+namespace {
+	enum class OnError : std::uint8_t {
+		STOP, // The sweep ends at the instruction, like `sweep`
+		SKIP_BYTE, // The byte is recorded as a length of 0 and the sweep continues at the next one
+	};
+
+	// The bytes an entry of `lengths` stands for, a skipped byte has a length of 0
+	constexpr std::size_t consumed(std::uint8_t length) { return length == 0 ? 1 : length; }
+
+	// The instructions of a chunk, decoded from the first byte of the chunk, which may not be an instruction boundary.
+	// Decoding stops at the first instruction that starts in the next chunk, or at the first error unless errors are skipped.
+	struct SpeculativeChunk {
+		std::size_t begin;
+		std::size_t end;
+
+		std::vector<std::uint8_t> lengths;
+		std::optional<Error> error; // Error at `begin + sum(lengths)`
+	};
+
+	template <MachineMode Mode, OnError Policy>
+	void decode_chunk(std::span<const std::byte> bytes, SpeculativeChunk& chunk)
+	{
+		// Most instructions are at least 3 bytes long
+		chunk.lengths.reserve((chunk.end - chunk.begin) / 3);
+
+		std::size_t offset = chunk.begin;
+		while (offset < chunk.end) {
+			const std::size_t remaining = bytes.size() - offset;
+			const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
+
+			const std::expected<std::uint8_t, Error> length = decode_length<Mode>(bytes.data() + offset, max_length, remaining);
+			if (!length.has_value()) {
+				if constexpr (Policy == OnError::STOP) {
+					chunk.error = length.error();
+					return;
+				}
+
+				chunk.lengths.push_back(0);
+				offset++;
+				continue;
+			}
+
+			chunk.lengths.push_back(length.value());
+			offset += length.value();
+		}
+	}
+
+	template <MachineMode Mode, OnError Policy>
+	std::expected<SweepResult, SweepError> parallel_sweep_impl(std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		unsigned threads,
+		const Detail::SweepTuning& tuning)
+	{
+		if (threads == 0)
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+		// Every entry of `lengths` stands for at most MAX_INSTRUCTION_LENGTH bytes, so `lengths` is full before the sweep gets past `limit`.
+		// Only the chunks are cut off there, the last instruction before it may still extend into the bytes after it.
+		const std::size_t limit = lengths.size() < bytes.size() / MAX_INSTRUCTION_LENGTH ? lengths.size() * MAX_INSTRUCTION_LENGTH : bytes.size();
+
+		const std::size_t chunk_count = std::clamp<std::size_t>(limit / std::max<std::size_t>(tuning.min_chunk_size, 1), 1, threads);
+		const std::size_t chunk_size = limit / chunk_count;
+
+		std::vector<SpeculativeChunk> chunks(chunk_count);
+		for (std::size_t i = 0; i < chunk_count; i++) {
+			chunks[i].begin = i * chunk_size;
+			chunks[i].end = i + 1 == chunk_count ? limit : (i + 1) * chunk_size;
+		}
+
+		{
+			std::vector<std::jthread> workers;
+			workers.reserve(chunk_count - 1);
+			for (std::size_t i = 1; i < chunk_count; i++)
+				workers.emplace_back([bytes, &chunk = chunks[i]] { decode_chunk<Mode, Policy>(bytes, chunk); });
+
+			decode_chunk<Mode, Policy>(bytes, chunks[0]);
+		}
+
+		// Stitch the chunks together, `offset` is always a true instruction boundary
+		std::size_t offset = 0;
+		std::size_t count = 0;
+
+		for (const SpeculativeChunk& chunk : chunks) {
+			std::size_t speculative_offset = chunk.begin;
+			std::size_t index = 0;
+
+			while (offset < chunk.end) {
+				while (index < chunk.lengths.size() && speculative_offset < offset)
+					speculative_offset += consumed(chunk.lengths[index++]);
+
+				if (speculative_offset == offset) {
+					// Both streams met, the rest of the speculative stream is correct
+					for (; index < chunk.lengths.size(); index++) {
+						if (count == lengths.size())
+							return SweepResult{ .count = count, .offset = offset };
+
+						lengths[count++] = chunk.lengths[index];
+						offset += consumed(chunk.lengths[index]);
+					}
+
+					if (chunk.error.has_value() && count < lengths.size())
+						return std::unexpected(SweepError{ .error = chunk.error.value(), .count = count, .offset = offset });
+
+					break;
+				}
+
+				// The speculative stream is either behind or ahead of the true one, so decode one more true instruction
+				if (count == lengths.size())
+					return SweepResult{ .count = count, .offset = offset };
+
+				const std::size_t remaining = bytes.size() - offset;
+				const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
+
+				const std::expected<std::uint8_t, Error> length = decode_length<Mode>(bytes.data() + offset, max_length, remaining);
+				if (!length.has_value()) {
+					if constexpr (Policy == OnError::STOP)
+						return std::unexpected(SweepError{ .error = length.error(), .count = count, .offset = offset });
+
+					lengths[count++] = 0;
+					offset++;
+					continue;
+				}
+
+				lengths[count++] = length.value();
+				offset += length.value();
+			}
+		}
+
+		return SweepResult{ .count = count, .offset = offset };
+	}
+
+	template <OnError Policy>
+	std::expected<SweepResult, SweepError> parallel_sweep_for(std::span<const std::byte> bytes,
+		std::span<std::uint8_t> lengths,
+		MachineMode mode,
+		unsigned threads,
+		const Detail::SweepTuning& tuning)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return parallel_sweep_impl<MachineMode::VIRTUAL8086, Policy>(bytes, lengths, threads, tuning);
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return parallel_sweep_impl<MachineMode::LONG_COMPATIBILITY_MODE, Policy>(bytes, lengths, threads, tuning);
+		case MachineMode::LONG_MODE:
+			return parallel_sweep_impl<MachineMode::LONG_MODE, Policy>(bytes, lengths, threads, tuning);
+		default:
+			std::unreachable();
+		}
+	}
+}
+
+std::expected<SweepResult, SweepError> LengthDisassembler::Detail::parallel_sweep(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	MachineMode mode,
+	unsigned threads,
+	const SweepTuning& tuning)
+{
+	return parallel_sweep_for<OnError::STOP>(bytes, lengths, mode, threads, tuning);
+}
+
+SweepResult LengthDisassembler::Detail::parallel_sweep_skipping(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	MachineMode mode,
+	unsigned threads,
+	const SweepTuning& tuning)
+{
+	// Errors are skipped, so the sweep always ends with a result
+	return parallel_sweep_for<OnError::SKIP_BYTE>(bytes, lengths, mode, threads, tuning).value();
+}
+
+std::expected<SweepResult, SweepError> LengthDisassembler::parallel_sweep(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	MachineMode mode,
+	unsigned threads)
+{
+	return Detail::parallel_sweep(bytes, lengths, mode, threads, {});
+}
+
+SweepResult LengthDisassembler::parallel_sweep_skipping(std::span<const std::byte> bytes,
+	std::span<std::uint8_t> lengths,
+	MachineMode mode,
+	unsigned threads)
+{
+	return Detail::parallel_sweep_skipping(bytes, lengths, mode, threads, {});
+}
@@ -0,0 +1,446 @@
+#include "LengthDisassembler/Signature.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+using namespace LengthDisassembler;
+using namespace LengthDisassembler::Signature;
+
+namespace {
+	constexpr std::byte SOLID{ 0xFF };
+	constexpr std::byte WILDCARD{ 0x00 };
+
+	std::optional<std::uint8_t> parse_nibble(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return std::nullopt;
+	}
+
+	// Addresses and relative offsets change whenever the code around them moves
+	bool is_volatile_displacement(const Instruction& instruction, MachineMode mode)
+	{
+		if (instruction.is_rip_relative)
+			return true;
+		if (instruction.modrm_offset == 0) // moffs
+			return true;
+		return mode != MachineMode::LONG_MODE && instruction.disp_size == instruction.address_bits / 8;
+	}
+
+	bool is_volatile_immediate(const Instruction& instruction, MachineMode mode)
+	{
+		if (instruction.is_relative_branch)
+			return true;
+		return mode != MachineMode::LONG_MODE && instruction.imm_size >= 4;
+	}
+
+	// Compares `pattern[begin, end)` against the code at `candidate`
+	bool matches_range(const Pattern& pattern, std::span<const std::byte> code, std::size_t candidate, std::size_t begin, std::size_t end)
+	{
+		if (candidate + end > code.size())
+			return false;
+
+		for (std::size_t i = begin; i < end; i++) {
+			if ((code[candidate + i] & pattern.mask[i]) != (pattern.bytes[i] & pattern.mask[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// Common opcodes and immediates make for a poor anchor
+	constexpr bool is_common(std::byte byte)
+	{
+		switch (static_cast<std::uint8_t>(byte)) {
+		case 0x00:
+		case 0x0F:
+		case 0x48:
+		case 0x89:
+		case 0x8B:
+		case 0xCC:
+		case 0xE8:
+		case 0xFF:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+std::optional<Pattern> Pattern::parse(std::string_view string)
+{
+	Pattern pattern;
+
+	std::size_t i = 0;
+	while (i < string.length()) {
+		if (string[i] == ' ') {
+			i++;
+			continue;
+		}
+
+		if (string[i] == '?') {
+			i += i + 1 < string.length() && string[i + 1] == '?' ? 2 : 1;
+			pattern.bytes.push_back(std::byte{ 0 });
+			pattern.mask.push_back(WILDCARD);
+		} else {
+			if (i + 1 >= string.length())
+				return std::nullopt;
+
+			const std::optional<std::uint8_t> high = parse_nibble(string[i]);
+			const std::optional<std::uint8_t> low = parse_nibble(string[i + 1]);
+			if (!high.has_value() || !low.has_value())
+				return std::nullopt;
+
+			i += 2;
+			pattern.bytes.push_back(static_cast<std::byte>(high.value() << 4 | low.value()));
+			pattern.mask.push_back(SOLID);
+		}
+
+		if (i < string.length() && string[i] != ' ')
+			return std::nullopt;
+	}
+
+	return pattern;
+}
+
+std::string Pattern::to_string() const
+{
+	static constexpr std::string_view DIGITS = "0123456789ABCDEF";
+
+	std::string string;
+	string.reserve(bytes.size() * 3);
+	for (std::size_t i = 0; i < bytes.size(); i++) {
+		if (i != 0)
+			string += ' ';
+
+		if (mask[i] == WILDCARD) {
+			string += "??";
+		} else {
+			const auto byte = static_cast<std::uint8_t>(bytes[i]);
+			string += DIGITS[byte >> 4];
+			string += DIGITS[byte & 0xF];
+		}
+	}
+	return string;
+}
+
+bool Pattern::matches(std::span<const std::byte> other) const
+{
+	for (std::size_t i = 0; i < bytes.size(); i++) {
+		if ((other[i] & mask[i]) != (bytes[i] & mask[i]))
+			return false;
+	}
+	return true;
+}
+
+std::expected<Pattern, GenerateError> LengthDisassembler::Signature::generate(
+	std::span<const std::byte> code,
+	std::size_t offset,
+	MachineMode mode,
+	std::size_t max_length)
+{
+	Pattern pattern;
+	std::vector<std::size_t> candidates; // Offsets that match the pattern so far, including `offset` itself
+
+	while (pattern.bytes.size() < max_length) {
+		const std::size_t cursor = offset + pattern.bytes.size();
+		if (cursor >= code.size())
+			return std::unexpected(GenerateError::NOT_UNIQUE);
+
+		const auto max_instruction_length = static_cast<std::uint8_t>(std::min<std::size_t>(code.size() - cursor, MAX_INSTRUCTION_LENGTH));
+		const std::expected<Instruction, Error> instruction = disassemble(code.data() + cursor, mode, max_instruction_length);
+		if (!instruction.has_value())
+			return std::unexpected(GenerateError::UNDECODABLE);
+
+		std::array<std::byte, MAX_INSTRUCTION_LENGTH> mask;
+		std::ranges::fill(mask, SOLID);
+		if (is_volatile_displacement(*instruction, mode))
+			std::fill_n(mask.begin() + instruction->disp_offset, instruction->disp_size, WILDCARD);
+		if (is_volatile_immediate(*instruction, mode))
+			std::fill_n(mask.begin() + instruction->imm_offset, instruction->imm_size, WILDCARD);
+
+		const std::size_t previous_length = pattern.bytes.size();
+		const std::span<const std::byte> bytes = code.subspan(cursor, instruction->length);
+		pattern.bytes.insert(pattern.bytes.end(), bytes.begin(), bytes.end());
+		pattern.mask.insert(pattern.mask.end(), mask.begin(), mask.begin() + instruction->length);
+
+		// The first instruction starts out with every offset that has the same first byte, as it may be unique after fewer bytes than it has
+		if (previous_length == 0) {
+			for (std::size_t candidate = 0; candidate < code.size(); candidate++) {
+				if (matches_range(pattern, code, candidate, 0, 1))
+					candidates.push_back(candidate);
+			}
+		}
+
+		std::vector<std::size_t> remaining;
+		for (const std::size_t candidate : candidates) {
+			if (matches_range(pattern, code, candidate, previous_length, pattern.bytes.size()))
+				remaining.push_back(candidate);
+		}
+
+		if (remaining.size() > 1) {
+			candidates = std::move(remaining);
+			continue;
+		}
+
+		// The last instruction made the pattern unique, but maybe not all of its bytes are needed, including when it is the first one
+		std::size_t length;
+		for (length = previous_length + 1; length < pattern.bytes.size(); length++) {
+			const bool unique = std::ranges::none_of(candidates, [&](std::size_t candidate) {
+				return candidate != offset && matches_range(pattern, code, candidate, previous_length, length);
+			});
+			if (unique)
+				break;
+		}
+
+		if (length > max_length)
+			return std::unexpected(GenerateError::NOT_UNIQUE);
+
+		pattern.bytes.resize(length);
+		pattern.mask.resize(length);
+		return pattern;
+	}
+
+	return std::unexpected(GenerateError::NOT_UNIQUE);
+}
+
+Scanner::Scanner(std::span<const Pattern> patterns)
+{
+	// Anchors are windows of the pattern, bytes past the end of short patterns are wildcards
+	const auto windows = [](const Pattern& pattern) {
+		return pattern.bytes.size() < ANCHOR_LENGTH ? 1 : pattern.bytes.size() - ANCHOR_LENGTH + 1;
+	};
+	const auto anchor_at = [](const Pattern& pattern, std::size_t window) {
+		Anchor anchor{};
+		for (std::size_t j = 0; j < ANCHOR_LENGTH && window + j < pattern.bytes.size(); j++) {
+			if (pattern.mask[window + j] == WILDCARD)
+				continue;
+			anchor.mask |= 0xFFU << (8 * j);
+			anchor.value |= static_cast<std::uint32_t>(pattern.bytes[window + j]) << (8 * j);
+		}
+		return anchor;
+	};
+	const auto combined = [](Anchor anchor) { return static_cast<std::uint64_t>(anchor.mask) << 32 | anchor.value; };
+
+	// Patterns that share an anchor are compared together, so anchors are picked to be as unique as possible
+	std::unordered_map<std::uint64_t, std::size_t> anchor_counts;
+	for (const Pattern& pattern : patterns) {
+		std::unordered_set<std::uint64_t> keys;
+		for (std::size_t window = 0; window < windows(pattern); window++)
+			keys.insert(combined(anchor_at(pattern, window)));
+		for (const std::uint64_t key : keys)
+			anchor_counts[key]++;
+	}
+
+	std::vector<Anchor> anchors;
+	for (std::size_t i = 0; i < patterns.size(); i++) {
+		const Pattern& pattern = patterns[i];
+		if (pattern.bytes.empty())
+			continue;
+
+		// Prefer the window with the most solid bytes, then the least shared one, then the one with the most distinctive bytes
+		std::size_t best_window = 0;
+		std::tuple<int, std::size_t, int> best{ -1, 0, 0 };
+		for (std::size_t window = 0; window < windows(pattern); window++) {
+			const Anchor anchor = anchor_at(pattern, window);
+
+			int distinctiveness = 0;
+			for (std::size_t j = window; j < std::min(window + ANCHOR_LENGTH, pattern.bytes.size()); j++) {
+				if (pattern.mask[j] != WILDCARD)
+					distinctiveness += is_common(pattern.bytes[j]) ? 1 : 2;
+			}
+
+			const std::tuple<int, std::size_t, int> rank{ std::popcount(anchor.mask), anchor_counts[combined(anchor)], distinctiveness };
+			if (std::get<0>(rank) > std::get<0>(best)
+				|| (std::get<0>(rank) == std::get<0>(best) && (std::get<1>(rank) < std::get<1>(best) || (std::get<1>(rank) == std::get<1>(best) && std::get<2>(rank) > std::get<2>(best))))) {
+				best = rank;
+				best_window = window;
+			}
+		}
+
+		entries.push_back({
+			.pattern = i,
+			.begin = pattern_bytes.size(),
+			.length = pattern.bytes.size(),
+			.anchor = best_window,
+		});
+		anchors.push_back(anchor_at(pattern, best_window));
+		pattern_bytes.insert(pattern_bytes.end(), pattern.bytes.begin(), pattern.bytes.end());
+		pattern_mask.insert(pattern_mask.end(), pattern.mask.begin(), pattern.mask.end());
+	}
+
+	for (const Anchor anchor : anchors) {
+		for (std::size_t j = 0; j < ANCHOR_LENGTH; j++) {
+			if ((anchor.mask >> (8 * j) & 0xFF) != 0) {
+				anchor_sets[j].insert(static_cast<std::uint8_t>(anchor.value >> (8 * j)));
+				continue;
+			}
+
+			for (unsigned any = 0; any < 256; any++)
+				anchor_sets[j].insert(static_cast<std::uint8_t>(any));
+		}
+
+		if (std::ranges::none_of(anchor_tables, [&](const AnchorTable& table) { return table.mask == anchor.mask; }))
+			anchor_tables.push_back({ .mask = anchor.mask, .ranges = {}, .entries = {} });
+	}
+
+	// The most selective tables come first
+	std::ranges::sort(anchor_tables, [](const AnchorTable& a, const AnchorTable& b) {
+		return std::popcount(a.mask) > std::popcount(b.mask);
+	});
+
+	for (AnchorTable& table : anchor_tables) {
+		const std::size_t count = std::ranges::count(anchors, table.mask, &Anchor::mask);
+
+		// Keep the table at most a quarter full
+		table.shift = 32 - static_cast<unsigned>(std::clamp<std::size_t>(std::bit_width(count * 4), 1, 24));
+		table.ranges.resize((std::size_t{ 1 } << (32 - table.shift)) + 1);
+
+		// Counting sort by hash
+		for (const Anchor anchor : anchors) {
+			if (anchor.mask == table.mask)
+				table.ranges[table.slot(anchor.value) + 1]++;
+		}
+		for (std::size_t i = 1; i < table.ranges.size(); i++)
+			table.ranges[i] += table.ranges[i - 1];
+
+		std::vector<std::size_t> cursors = table.ranges;
+		table.entries.resize(count);
+		for (std::size_t i = 0; i < anchors.size(); i++) {
+			if (anchors[i].mask == table.mask)
+				table.entries[cursors[table.slot(anchors[i].value)]++] = i;
+		}
+	}
+}
+
+// `position` is where the anchor would start in `bytes`
+void Scanner::verify(std::span<const std::byte> bytes, std::size_t position, std::vector<Match>& matches) const
+{
+	// Anchor bytes past the end are zero, patterns that don't fit are rejected when comparing
+	std::uint32_t window = 0;
+	for (std::size_t j = 0; j < ANCHOR_LENGTH && position + j < bytes.size(); j++)
+		window |= static_cast<std::uint32_t>(bytes[position + j]) << (8 * j);
+
+	for (const AnchorTable& table : anchor_tables) {
+		const std::size_t slot = table.slot(window & table.mask);
+		for (std::size_t i = table.ranges[slot]; i < table.ranges[slot + 1]; i++) {
+			const Entry& entry = entries[table.entries[i]];
+			if (position < entry.anchor || position - entry.anchor + entry.length > bytes.size())
+				continue;
+
+			const std::size_t start = position - entry.anchor;
+			bool matched = true;
+			for (std::size_t k = 0; k < entry.length; k++) {
+				if ((bytes[start + k] & pattern_mask[entry.begin + k]) != (pattern_bytes[entry.begin + k] & pattern_mask[entry.begin + k])) {
+					matched = false;
+					break;
+				}
+			}
+
+			if (matched)
+				matches.push_back({ .pattern = entry.pattern, .offset = start });
+		}
+	}
+}
+
+void Scanner::scan_scalar(std::span<const std::byte> bytes, std::size_t position, std::vector<Match>& matches) const
+{
+	for (; position < bytes.size(); position++) {
+		// Anchor bytes past the end are ignored, patterns that don't fit are rejected by `verify`
+		bool candidate = true;
+		for (std::size_t j = 0; j < ANCHOR_LENGTH && position + j < bytes.size(); j++)
+			candidate &= anchor_sets[j].contains(static_cast<std::uint8_t>(bytes[position + j]));
+
+		if (candidate)
+			verify(bytes, position, matches);
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Returns the position at which the scalar scan has to take over
+[[gnu::target("avx2")]] std::size_t Scanner::scan_avx2(std::span<const std::byte> bytes, std::vector<Match>& matches) const
+{
+	static constexpr std::size_t VECTOR_SIZE = 32;
+
+	const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+	const __m256i high_nibble_bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+	__m256i rows[ANCHOR_LENGTH][2]; // std::array would drop the alignment of __m256i
+	for (std::size_t j = 0; j < ANCHOR_LENGTH; j++) {
+		for (std::size_t half = 0; half < 2; half++)
+			rows[j][half] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(anchor_sets[j].rows[half].data())));
+	}
+
+	std::size_t position = 0;
+	for (; position + VECTOR_SIZE + ANCHOR_LENGTH - 1 <= bytes.size(); position += VECTOR_SIZE) {
+		__m256i misses = _mm256_setzero_si256();
+		for (std::size_t j = 0; j < ANCHOR_LENGTH; j++) {
+			const __m256i vector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes.data() + position + j));
+			const __m256i low = _mm256_and_si256(vector, nibble_mask);
+			const __m256i high = _mm256_and_si256(_mm256_srli_epi16(vector, 4), nibble_mask);
+
+			// The top bit of each byte picks the row
+			const __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(rows[j][0], low), _mm256_shuffle_epi8(rows[j][1], low), vector);
+			const __m256i bit = _mm256_shuffle_epi8(high_nibble_bits, high);
+			misses = _mm256_or_si256(misses, _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256()));
+		}
+
+		auto hits = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(misses));
+		while (hits != 0) {
+			verify(bytes, position + std::countr_zero(hits), matches);
+			hits &= hits - 1;
+		}
+	}
+
+	return position;
+}
+#endif
+
+std::vector<Match> Scanner::scan(std::span<const std::byte> bytes) const
+{
+	return scan(bytes, true);
+}
+
+std::vector<Match> Scanner::scan(std::span<const std::byte> bytes, bool vectorized) const
+{
+	std::vector<Match> matches;
+	if (entries.empty())
+		return matches;
+
+	std::size_t position = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (vectorized && __builtin_cpu_supports("avx2"))
+		position = scan_avx2(bytes, matches);
+#else
+	static_cast<void>(vectorized);
+#endif
+	scan_scalar(bytes, position, matches);
+
+	// Patterns are found by the position of their anchor, which differs from pattern to pattern
+	std::ranges::sort(matches, [](const Match& a, const Match& b) {
+		return std::pair{ a.offset, a.pattern } < std::pair{ b.offset, b.pattern };
+	});
+	return matches;
+}
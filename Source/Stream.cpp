@@ -0,0 +1,158 @@
+#include "LengthDisassembler/Stream.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <utility>
+
+#include "LengthDisassembler/Detail/Decoder.hpp"
+
+using namespace LengthDisassembler;
+using Detail::decode;
+
+StreamDecoder::StreamDecoder(MachineMode mode)
+	: machine_mode(mode)
+{
+}
+
+std::size_t StreamDecoder::needed() const
+{
+	const std::size_t waiting = carry_end - carry_begin;
+	if (failure.has_value() || waiting == 0)
+		return 0;
+	return MAX_INSTRUCTION_LENGTH - waiting;
+}
+
+template <MachineMode Mode>
+std::expected<SweepResult, SweepError> StreamDecoder::feed_impl(std::span<const std::byte> chunk, std::span<std::uint8_t> lengths)
+{
+	SweepResult result{ .count = 0, .offset = 0 };
+
+	const auto fail = [this, &result](Error error) {
+		failure = SweepError{ .error = error, .count = 0, .offset = stream_offset };
+		return std::unexpected(SweepError{ .error = error, .count = result.count, .offset = stream_offset });
+	};
+
+	// Instructions that start in a previous chunk are decoded from the carry-over buffer, once enough of this chunk has been appended.
+	// The buffer never holds more than MAX_INSTRUCTION_LENGTH - 1 waiting bytes, so there is always room for a full instruction behind them.
+	std::size_t offset = 0;
+	if (carry_begin != carry_end) {
+		std::copy(carry.begin() + carry_begin, carry.begin() + carry_end, carry.begin());
+		carry_end -= carry_begin;
+		carry_begin = 0;
+
+		const std::size_t waiting = carry_end;
+		const std::size_t appended = std::min(chunk.size(), carry.size() - carry_end);
+		std::copy_n(chunk.begin(), appended, carry.begin() + carry_end);
+		carry_end += appended;
+
+		while (carry_begin < waiting && carry_end - carry_begin >= MAX_INSTRUCTION_LENGTH) {
+			if (result.count == lengths.size()) {
+				// Give the appended bytes back, they are passed again
+				carry_end = waiting;
+				return result;
+			}
+
+			const std::expected<Instruction, Error> instruction = decode<Mode>(carry.data() + carry_begin, MAX_INSTRUCTION_LENGTH, carry_end - carry_begin);
+			if (!instruction.has_value())
+				return fail(instruction.error());
+
+			lengths[result.count++] = instruction->length;
+			carry_begin += instruction->length;
+			stream_offset += instruction->length;
+		}
+
+		if (carry_begin < waiting) {
+			// The chunk is too small to complete the next instruction, all of it is waiting now
+			result.offset = chunk.size();
+			return result;
+		}
+
+		// The next instruction starts in this chunk
+		offset = carry_begin - waiting;
+		carry_begin = 0;
+		carry_end = 0;
+	}
+
+	while (chunk.size() - offset >= MAX_INSTRUCTION_LENGTH) {
+		if (result.count == lengths.size()) {
+			result.offset = offset;
+			return result;
+		}
+
+		const std::expected<Instruction, Error> instruction = decode<Mode>(chunk.data() + offset, MAX_INSTRUCTION_LENGTH, chunk.size() - offset);
+		if (!instruction.has_value())
+			return fail(instruction.error());
+
+		lengths[result.count++] = instruction->length;
+		offset += instruction->length;
+		stream_offset += instruction->length;
+	}
+
+	// The last few bytes wait for the next chunk
+	std::copy(chunk.begin() + static_cast<std::ptrdiff_t>(offset), chunk.end(), carry.begin());
+	carry_end = chunk.size() - offset;
+
+	result.offset = chunk.size();
+	return result;
+}
+
+template <MachineMode Mode>
+std::expected<SweepResult, SweepError> StreamDecoder::finish_impl(std::span<std::uint8_t> lengths)
+{
+	SweepResult result{ .count = 0, .offset = 0 };
+
+	while (carry_begin != carry_end && result.count != lengths.size()) {
+		const std::size_t remaining = carry_end - carry_begin;
+		const auto max_length = static_cast<std::uint8_t>(std::min<std::size_t>(remaining, MAX_INSTRUCTION_LENGTH));
+
+		const std::expected<Instruction, Error> instruction = decode<Mode>(carry.data() + carry_begin, max_length, remaining);
+		if (!instruction.has_value()) {
+			failure = SweepError{ .error = instruction.error(), .count = 0, .offset = stream_offset };
+			return std::unexpected(SweepError{ .error = instruction.error(), .count = result.count, .offset = stream_offset });
+		}
+
+		lengths[result.count++] = instruction->length;
+		carry_begin += instruction->length;
+		stream_offset += instruction->length;
+		result.offset += instruction->length;
+	}
+
+	return result;
+}
+
+std::expected<SweepResult, SweepError> StreamDecoder::feed(std::span<const std::byte> chunk, std::span<std::uint8_t> lengths)
+{
+	if (failure.has_value())
+		return std::unexpected(failure.value());
+
+	switch (machine_mode) {
+	case MachineMode::VIRTUAL8086:
+		return feed_impl<MachineMode::VIRTUAL8086>(chunk, lengths);
+	case MachineMode::LONG_COMPATIBILITY_MODE:
+		return feed_impl<MachineMode::LONG_COMPATIBILITY_MODE>(chunk, lengths);
+	case MachineMode::LONG_MODE:
+		return feed_impl<MachineMode::LONG_MODE>(chunk, lengths);
+	default:
+		std::unreachable();
+	}
+}
+
+std::expected<SweepResult, SweepError> StreamDecoder::finish(std::span<std::uint8_t> lengths)
+{
+	if (failure.has_value())
+		return std::unexpected(failure.value());
+
+	switch (machine_mode) {
+	case MachineMode::VIRTUAL8086:
+		return finish_impl<MachineMode::VIRTUAL8086>(lengths);
+	case MachineMode::LONG_COMPATIBILITY_MODE:
+		return finish_impl<MachineMode::LONG_COMPATIBILITY_MODE>(lengths);
+	case MachineMode::LONG_MODE:
+		return finish_impl<MachineMode::LONG_MODE>(lengths);
+	default:
+		std::unreachable();
+	}
+}
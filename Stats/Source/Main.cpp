@@ -0,0 +1,135 @@
+#include "LengthDisassembler/Elf.hpp"
+#include "LengthDisassembler/LengthDisassembler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <expected>
+#include <iostream>
+#include <print>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace LengthDisassembler;
+
+namespace {
+	constexpr int bits_of(MachineMode mode)
+	{
+		switch (mode) {
+		case MachineMode::VIRTUAL8086:
+			return 16;
+		case MachineMode::LONG_COMPATIBILITY_MODE:
+			return 32;
+		case MachineMode::LONG_MODE:
+			return 64;
+		default:
+			std::unreachable();
+		}
+	}
+
+	std::string_view describe(Elf::LoadError error)
+	{
+		switch (error) {
+		case Elf::LoadError::OPEN_FAILED:
+			return "Failed to open file";
+		case Elf::LoadError::MAPPING_FAILED:
+			return "Failed to map file";
+		case Elf::LoadError::NOT_ELF:
+			return "Not an ELF file";
+		case Elf::LoadError::UNSUPPORTED_MACHINE:
+			return "Not an x86 or x86-64 ELF file";
+		case Elf::LoadError::MALFORMED:
+			return "Malformed ELF file";
+		default:
+			std::unreachable();
+		}
+	}
+
+	struct Statistics {
+		std::size_t instructions = 0;
+		std::size_t undecodable_bytes = 0; // Bytes that had to be skipped after an error
+		std::array<std::size_t, MAX_INSTRUCTION_LENGTH + 1> histogram{};
+	};
+
+	// Sweeps the whole range in a single pass, skipping a single byte whenever an instruction can't be decoded.
+	// `lengths` has to be as large as the range, every byte could be an instruction or a skipped byte of its own.
+	Statistics sweep_range(std::span<const std::byte> bytes, MachineMode mode, unsigned threads, std::span<std::uint8_t> lengths)
+	{
+		const SweepResult result = parallel_sweep_skipping(bytes, lengths, mode, threads);
+
+		Statistics statistics;
+		for (const std::uint8_t length : lengths.first(result.count))
+			statistics.histogram[length]++;
+
+		// Skipped bytes are recorded as a length of 0
+		statistics.undecodable_bytes = statistics.histogram[0];
+		statistics.instructions = result.count - statistics.undecodable_bytes;
+		return statistics;
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc < 2 || argc > 3) {
+		std::println(std::cerr, "Usage: {} <elf file> [threads]", argv[0]);
+		return 1;
+	}
+
+	const unsigned threads = argc == 3 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 0;
+
+	const std::expected<Elf::File, Elf::LoadError> file = Elf::File::open(argv[1]);
+	if (!file.has_value()) {
+		if (file.error() == Elf::LoadError::OPEN_FAILED || file.error() == Elf::LoadError::MAPPING_FAILED)
+			std::println(std::cerr, "{}: {} ({})", argv[1], describe(file.error()), std::strerror(errno));
+		else
+			std::println(std::cerr, "{}: {}", argv[1], describe(file.error()));
+		return 1;
+	}
+
+	std::size_t largest = 0;
+	for (const Elf::CodeRange& range : file->code())
+		largest = std::max(largest, range.bytes.size());
+
+	// Every byte could be an instruction of its own
+	std::vector<std::uint8_t> lengths(largest);
+
+	std::println("{}: {}-bit", argv[1], bits_of(file->mode()));
+
+	Statistics total;
+	std::size_t total_bytes = 0;
+	for (const Elf::CodeRange& range : file->code()) {
+		const Statistics statistics = sweep_range(range.bytes, file->mode(), threads, std::span{ lengths }.first(range.bytes.size()));
+
+		std::println("{:<24} {:#018x} {:>12} bytes {:>12} instructions {:>8} undecodable bytes",
+			range.name.empty() ? "<segment>" : range.name,
+			range.address,
+			range.bytes.size(),
+			statistics.instructions,
+			statistics.undecodable_bytes);
+
+		total.instructions += statistics.instructions;
+		total.undecodable_bytes += statistics.undecodable_bytes;
+		for (std::size_t length = 0; length < total.histogram.size(); length++)
+			total.histogram[length] += statistics.histogram[length];
+		total_bytes += range.bytes.size();
+	}
+
+	std::println("Total: {} bytes, {} instructions, {} undecodable bytes", total_bytes, total.instructions, total.undecodable_bytes);
+
+	if (total.instructions == 0)
+		return 0;
+
+	std::println("Length histogram:");
+	for (std::size_t length = 1; length < total.histogram.size(); length++) {
+		std::println("{:>4} {:>12} {:>6.2f}%",
+			length,
+			total.histogram[length],
+			100.0 * static_cast<double>(total.histogram[length]) / static_cast<double>(total.instructions));
+	}
+}
@@ -21,6 +21,6 @@ cd build
 mv test.json "$base_dir/"
 # shellcheck disable=SC2164
 cd "$base_dir"
-cargo run --release
+cargo run --release -- --histogram opcode_histogram.txt
 
 cd "$previous_dir" || exit
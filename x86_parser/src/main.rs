@@ -1,8 +1,13 @@
-use std::{fs::OpenOptions, hash::Hash, io::Write};
+use std::{collections::HashMap, fs::OpenOptions, hash::Hash, io::Write};
 
 use itertools::Itertools;
 use json::JsonValue;
 
+mod profile;
+mod special_cases;
+
+use special_cases::SpecialCase;
+
 #[derive(Clone, Debug)]
 struct ParsedInstruction {
     pattern: String,
@@ -105,7 +110,7 @@ fn parse_instructions(instructions: &JsonValue) -> Vec<Vec<Vec<ParsedInstruction
         ];
 
         if EXPLICITLY_HANDLED.contains(&(map, opcode)) {
-            // These ones are handled explicitly in the length disassembler,
+            // These ones are described by special_cases.rs, or by whatever range covers them,
             // because they encode too many different instructions...
             continue;
         }
@@ -191,6 +196,7 @@ fn parse_instructions(instructions: &JsonValue) -> Vec<Vec<Vec<ParsedInstruction
 
         // These 2 conditions can also be used, but currently the struct is exactly 1 byte big,
         // so there is no reason to improve anything until a new field needs to be added.
+        // disp_asz together with disp_osz marks the special cases, see place_special_cases.
         assert!(!disp_osz || !disp_asz);
         assert!(!imm_osz || !uimm_osz);
 
@@ -331,7 +337,67 @@ fn build_fat_table(
     dominated_opcode_map
 }
 
-fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
+// A range that describes no instruction itself, but the special case whose index is in `fixed`
+fn special_case_marker(index: usize) -> ParsedInstruction {
+    ParsedInstruction {
+        pattern: String::new(),
+        iclass: format!("SPECIAL_CASES[{index}]"),
+        modrm: false,
+        fixed: index as u8,
+        disp_asz: true,
+        disp_osz: true,
+        imm_osz: false,
+        uimm_osz: false,
+        cloned_from: None,
+    }
+}
+
+fn is_special_case_marker(insn: &ParsedInstruction) -> bool {
+    insn.disp_asz && insn.disp_osz
+}
+
+// As the first matching range wins, every special case is placed right before the first range that covers it,
+// which leaves the scan for every other opcode as long as it was. A special case that no range covers goes first.
+fn place_special_cases(
+    rules: Vec<((usize, usize), ParsedInstruction)>,
+    map: usize,
+    special_cases: &[SpecialCase],
+) -> Vec<((usize, usize), ParsedInstruction)> {
+    let covers = |(from, to): (usize, usize), special_case: &SpecialCase| {
+        from <= special_case.to as usize && special_case.from as usize <= to
+    };
+
+    let mut placed = Vec::new();
+    for i in 0..=rules.len() {
+        for (index, special_case) in special_cases.iter().enumerate() {
+            if special_case.map != map {
+                continue;
+            }
+
+            let first_cover = rules
+                .iter()
+                .position(|(range, _)| covers(*range, special_case))
+                .unwrap_or(0);
+            if first_cover == i {
+                placed.push((
+                    (special_case.from as usize, special_case.to as usize),
+                    special_case_marker(index),
+                ));
+            }
+        }
+
+        if let Some(rule) = rules.get(i) {
+            placed.push(rule.clone());
+        }
+    }
+
+    placed
+}
+
+fn build_thin_table(
+    table: &[Vec<Option<ParsedInstruction>>],
+    histogram: Option<&HashMap<(usize, usize), u64>>,
+) {
     let mut thin_table = OpenOptions::new()
         .write(true)
         .create(true)
@@ -345,13 +411,37 @@ fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
     )
     .unwrap();
 
+    let special_cases = special_cases::special_cases();
+    assert!(special_cases.iter().all(|special_case| special_case.map < table.len()));
+
+    writeln!(thin_table, "constexpr SPECIAL_CASE SPECIAL_CASES[] = {{").unwrap();
+    for special_case in &special_cases {
+        writeln!(
+            thin_table,
+            "\tSPECIAL_CASE_DEF({}, {}, {}, SPECIAL_CASE_INFO_DEF({}, {}, {}, {}, {}, {}, {})), // {}",
+            special_case.map,
+            special_case.from,
+            special_case.to,
+            special_case.modrm,
+            special_case.modrm_only,
+            special_case.group_3,
+            special_case.disp_mode,
+            special_case.rel_mode,
+            special_case.fixed,
+            special_case.legacy_fixed,
+            special_case.comment,
+        )
+        .unwrap();
+    }
+    writeln!(thin_table, "}};\n").unwrap();
+
     let mut rules_counts = Vec::new();
 
     for (map, opcodes) in table.iter().enumerate() {
         eprintln!("Map: {map}");
         writeln!(
             thin_table,
-            "const OPCODE_INFO_RANGE OPCODE_TABLE_{map}[] = {{"
+            "constexpr OPCODE_INFO_RANGE OPCODE_TABLE_{map}[] = {{"
         )
         .unwrap();
 
@@ -403,6 +493,10 @@ fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
             break;
         }
 
+        if let Some(histogram) = histogram {
+            rules = profile::order_by_frequency(rules, map, histogram);
+        }
+
         for i in 0x00..=0xFF {
             let old = orig_opcodes.get(i).unwrap();
             if old.is_some() {
@@ -417,10 +511,12 @@ fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
             }
         }
 
+        let rules = place_special_cases(rules, map, &special_cases);
+
         for (range, instruction) in &rules {
             writeln!(
                 thin_table,
-                "\tRANGE_OPCODE_INSN_DEF({}, {}, OPCODE_INSN_DEF({}, {}, {}, {}, {}, {})),",
+                "\tRANGE_OPCODE_INSN_DEF({}, {}, OPCODE_INSN_DEF({}, {}, {}, {}, {}, {})),{}",
                 range.0,
                 range.1,
                 instruction.modrm,
@@ -429,6 +525,11 @@ fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
                 instruction.disp_osz,
                 instruction.imm_osz,
                 instruction.uimm_osz,
+                if is_special_case_marker(instruction) {
+                    format!(" // {}", instruction.iclass)
+                } else {
+                    "".to_owned()
+                },
             )
             .unwrap();
         }
@@ -439,7 +540,7 @@ fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
 
     writeln!(
         thin_table,
-        "const OPCODE_TABLE_DEFINITION OPCODE_TABLES[] = {{"
+        "constexpr OPCODE_TABLE_DEFINITION OPCODE_TABLES[] = {{"
     )
     .unwrap();
     for (map, _) in table.iter().enumerate() {
@@ -454,6 +555,14 @@ fn build_thin_table(table: &[Vec<Option<ParsedInstruction>>]) {
 }
 
 fn main() {
+    // Without a histogram, the ranges are emitted in the order they were found in, largest first
+    let args = std::env::args().collect::<Vec<_>>();
+    let histogram = match args.get(1..).unwrap_or_default() {
+        [] => None,
+        [flag, path] if flag == "--histogram" => Some(profile::read_histogram(path)),
+        _ => panic!("Usage: {} [--histogram <file>]", args[0]),
+    };
+
     let json = std::fs::read_to_string("./test.json").unwrap();
     let parsed = json::parse(&json).unwrap();
 
@@ -461,5 +570,5 @@ fn main() {
 
     let parsed_instructions = parse_instructions(instructions);
     let dominating_opcode_map = build_fat_table(&parsed_instructions);
-    build_thin_table(&dominating_opcode_map);
+    build_thin_table(&dominating_opcode_map, histogram.as_ref());
 }
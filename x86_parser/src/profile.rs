@@ -0,0 +1,76 @@
+use std::collections::HashMap;
+
+// How often every opcode of every map was executed, read from lines of `<map> <opcode> <count>`,
+// where the opcode is hexadecimal. Empty lines and lines starting with '#' are skipped.
+pub fn read_histogram(path: &str) -> HashMap<(usize, usize), u64> {
+    let text = std::fs::read_to_string(path).unwrap();
+
+    let mut histogram = HashMap::new();
+    for (number, line) in text.lines().enumerate() {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+
+        let fields = line.split_whitespace().collect::<Vec<_>>();
+        assert!(fields.len() == 3, "{path}:{}: expected `<map> <opcode> <count>`", number + 1);
+
+        let map = fields[0].parse::<usize>().unwrap();
+        let opcode = u8::from_str_radix(fields[1].trim_start_matches("0x"), 16).unwrap() as usize;
+        let count = fields[2].parse::<u64>().unwrap();
+
+        *histogram.entry((map, opcode)).or_insert(0) += count;
+    }
+
+    histogram
+}
+
+// The lookup stops at the first range that contains the opcode, so ranges can overlap as long as the earlier one wins.
+// Two ranges that overlap and describe different instructions therefore have to stay in their order,
+// every other pair can be swapped without changing what any opcode resolves to.
+//
+// Among the ranges whose predecessors are already placed, the one that takes over the most executions is placed next.
+// A range only takes over the opcodes that no range in front of it contains anymore.
+// Ties, e.g. ranges that are never executed, keep their original order.
+pub fn order_by_frequency<T: PartialEq>(
+    rules: Vec<((usize, usize), T)>,
+    map: usize,
+    histogram: &HashMap<(usize, usize), u64>,
+) -> Vec<((usize, usize), T)> {
+    let overlaps = |a: (usize, usize), b: (usize, usize)| a.0 <= b.1 && b.0 <= a.1;
+
+    let predecessors = (0..rules.len())
+        .map(|j| {
+            (0..j)
+                .filter(|&i| overlaps(rules[i].0, rules[j].0) && rules[i].1 != rules[j].1)
+                .collect::<Vec<_>>()
+        })
+        .collect::<Vec<_>>();
+
+    let mut placed = vec![false; rules.len()];
+    let mut covered = [false; 256];
+    let mut order = Vec::new();
+
+    while order.len() < rules.len() {
+        let next = (0..rules.len())
+            .filter(|&j| !placed[j] && predecessors[j].iter().all(|&i| placed[i]))
+            .max_by_key(|&j| {
+                let (from, to) = rules[j].0;
+                let executions = (from..=to)
+                    .filter(|&opcode| !covered[opcode])
+                    .map(|opcode| histogram.get(&(map, opcode)).copied().unwrap_or(0))
+                    .sum::<u64>();
+                // max_by_key returns the last maximum, so prefer the earlier rule explicitly
+                (executions, std::cmp::Reverse(j))
+            })
+            .unwrap();
+
+        let (from, to) = rules[next].0;
+        covered[from..=to].iter_mut().for_each(|opcode| *opcode = true);
+        placed[next] = true;
+        order.push(next);
+    }
+
+    let mut rules = rules.into_iter().map(Some).collect::<Vec<_>>();
+    order.into_iter().map(|j| rules[j].take().unwrap()).collect()
+}
@@ -0,0 +1,85 @@
+// Opcodes that encode too many different instructions for XED's patterns to agree on a size.
+// They are emitted as SPECIAL_CASES next to the range tables, and every range table gets a marker range for each of its special cases.
+
+// The immediate of group 3 (F6 and F7), which only TEST (ModRM.reg 0 and 1) has, 0 for every other opcode
+pub const GROUP_3_BYTE: u8 = 1;
+pub const GROUP_3_OSZ: u8 = 2;
+
+#[derive(Clone, Debug, Default)]
+pub struct SpecialCase {
+    pub map: usize,
+    pub from: u8,
+    pub to: u8,
+    pub comment: &'static str,
+
+    pub modrm: bool,
+    pub modrm_only: bool, // The ModRM byte always addresses registers, it is never followed by a SIB byte or a displacement
+    pub group_3: u8,
+    pub disp_mode: bool, // A displacement of the machine mode's size, regardless of the address size prefix
+    pub rel_mode: bool, // A relative branch displacement of 2 bytes in 16-bit mode, of the operand size in 32-bit mode and of 4 bytes in 64-bit mode
+    pub fixed: u8,
+    pub legacy_fixed: bool, // `fixed` only applies without a VEX prefix
+}
+
+// The index of a special case is stored in the 3 bits of `fixed` of its marker
+pub fn special_cases() -> Vec<SpecialCase> {
+    let special_cases = vec![
+        SpecialCase {
+            map: 0,
+            from: 0xF6,
+            to: 0xF6,
+            comment: "Group 3, TEST has a 1-byte immediate",
+            modrm: true,
+            group_3: GROUP_3_BYTE,
+            ..Default::default()
+        },
+        SpecialCase {
+            map: 0,
+            from: 0xF7,
+            to: 0xF7,
+            comment: "Group 3, TEST has an immediate of the operand size",
+            modrm: true,
+            group_3: GROUP_3_OSZ,
+            ..Default::default()
+        },
+        SpecialCase {
+            map: 0,
+            from: 0xA1,
+            to: 0xA1,
+            comment: "MOV EAX, moffs purposely ignores prefixes",
+            disp_mode: true,
+            ..Default::default()
+        },
+        SpecialCase {
+            map: 0,
+            from: 0xE8,
+            to: 0xE9,
+            comment: "CALL/JMP rel16/32",
+            rel_mode: true,
+            ..Default::default()
+        },
+        // TODO check that its not VMREAD
+        SpecialCase {
+            map: 1,
+            from: 0x78,
+            to: 0x78,
+            comment: "VMREAD or EXTRQ or INSERTQ, the latter two have two 1-byte immediates",
+            modrm: true,
+            fixed: 2,
+            legacy_fixed: true,
+            ..Default::default()
+        },
+        SpecialCase {
+            map: 1,
+            from: 0x20,
+            to: 0x21,
+            comment: "MOV CR/DR, take modrm, but just don't care about its displacement",
+            modrm: true,
+            modrm_only: true,
+            ..Default::default()
+        },
+    ];
+
+    assert!(special_cases.len() <= 8);
+    special_cases
+}